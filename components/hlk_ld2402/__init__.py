@@ -1,20 +1,138 @@
+import math
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome import automation
 from esphome.components import uart, text_sensor
-from esphome.const import CONF_ID, CONF_TIMEOUT, ENTITY_CATEGORY_DIAGNOSTIC
+from esphome.const import CONF_ID, CONF_TIMEOUT, CONF_TRIGGER_ID, ENTITY_CATEGORY_DIAGNOSTIC
+from esphome.core import CORE
 
 # Make sure text_sensor is listed as a direct dependency
 DEPENDENCIES = ["uart", "text_sensor"]
 AUTO_LOAD = ["sensor", "binary_sensor"]  # Remove text_sensor from AUTO_LOAD
 
 # Define our own constants
+DOMAIN = "hlk_ld2402"
 CONF_MAX_DISTANCE = "max_distance"
 CONF_HLK_LD2402_ID = "hlk_ld2402_id" 
+CONF_MOTION_THRESHOLDS = "motion_thresholds"
+CONF_MICROMOTION_THRESHOLDS = "micromotion_thresholds"
+CONF_SAVE_DELAY = "save_delay"
+CONF_FIRMWARE_VERSION_DELAY = "firmware_version_delay"
+CONF_POWER_INTERFERENCE_DELAY = "power_interference_delay"
+CONF_POWER_INTERFERENCE_INTERVAL = "power_interference_interval"
+CONF_STALL_TIMEOUT = "stall_timeout"
+CONF_ON_AUTO_GAIN_COMPLETE = "on_auto_gain_complete"
+CONF_CALIBRATION_POLL_INTERVAL = "calibration_poll_interval"
+CONF_CALIBRATION_TIMEOUT = "calibration_timeout"
+CONF_RETRY = "retry"
+CONF_ATTEMPTS = "attempts"
+CONF_BASE_DELAY = "base_delay"
+CONF_JITTER = "jitter"
+CONF_DEADLINE = "deadline"
+CONF_CIRCUIT_BREAKER = "circuit_breaker"
+CONF_FAILURE_THRESHOLD = "failure_threshold"
+CONF_COOLDOWN = "cooldown"
+CONF_FEATURES = "features"
+CONF_ENGINEERING_THROTTLE = "engineering_throttle"
+CONF_ENERGY_DEADBAND = "energy_deadband"
+CONF_ABSOLUTE = "absolute"
+CONF_RELATIVE = "relative"
+CONF_HEARTBEAT = "heartbeat"
+CONF_ENERGY_AGGREGATION = "energy_aggregation"
+CONF_PRESENCE = "presence"
+CONF_ENTER_FRAMES = "enter_frames"
+CONF_HOLD_TIME = "hold_time"
+CONF_RANGE = "range"
+CONF_RANGE_HYSTERESIS = "range_hysteresis"
+CONF_ON_TARGET_STATE = "on_target_state"
+
+# Optional subsystems and the defines that compile them in. Entities that need one enable
+# it from their platform; anything only called from lambdas has to be listed in features:.
+FEATURE_ENGINEERING = "engineering"
+FEATURE_CALIBRATION = "calibration"
+FEATURE_TEXT_PROTOCOL = "text_protocol"
+FEATURE_THRESHOLDS = "thresholds"
+FEATURE_DISTANCE_FILTER = "distance_filter"
+FEATURE_DEFINES = {
+    FEATURE_ENGINEERING: "USE_HLK_LD2402_ENGINEERING",
+    FEATURE_CALIBRATION: "USE_HLK_LD2402_CALIBRATION",
+    FEATURE_TEXT_PROTOCOL: "USE_HLK_LD2402_TEXT_PROTOCOL",
+    FEATURE_THRESHOLDS: "USE_HLK_LD2402_THRESHOLDS",
+    FEATURE_DISTANCE_FILTER: "USE_HLK_LD2402_DISTANCE_FILTER",
+}
+
+
+def enable_feature(feature):
+    cg.add_define(FEATURE_DEFINES[feature])
+
+# Parameter IDs 0x0010-0x001F and 0x0030-0x003F - one threshold per gate
+THRESHOLD_GATES = 16
+GATE_SIZE_M = 0.7
+
+
+def active_gates(config):
+    """Gates within max_distance; all of them when no range is declared."""
+    if CONF_MAX_DISTANCE not in config:
+        return THRESHOLD_GATES
+    # Round first so 2.1 m stays 3 gates despite 2.1 / 0.7 == 3.0000000000000004
+    return min(THRESHOLD_GATES, math.ceil(round(config[CONF_MAX_DISTANCE] / GATE_SIZE_M, 6)))
+
+GATE_THRESHOLDS_SCHEMA = cv.All(
+    cv.ensure_list(cv.float_range(min=0.0, max=95.0)),
+    cv.Length(max=THRESHOLD_GATES),
+)
+
+RETRY_SCHEMA = cv.Schema({
+    cv.Optional(CONF_ATTEMPTS, default=3): cv.int_range(min=1, max=10),
+    cv.Optional(CONF_BASE_DELAY, default="250ms"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_JITTER, default="100ms"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_DEADLINE, default="5s"): cv.positive_time_period_milliseconds,
+})
+
+CIRCUIT_BREAKER_SCHEMA = cv.Schema({
+    cv.Optional(CONF_FAILURE_THRESHOLD, default=6): cv.int_range(min=1, max=255),
+    cv.Optional(CONF_COOLDOWN, default="60s"): cv.positive_time_period_milliseconds,
+})
+
+# A gate's energy sensor publishes when the value moves by more than the wider of the two
+# bands since its last publish, or when the heartbeat is due
+ENERGY_DEADBAND_SCHEMA = cv.Schema({
+    cv.Optional(CONF_ABSOLUTE, default=1.0): cv.float_range(min=0.0, max=95.0),
+    cv.Optional(CONF_RELATIVE, default="0%"): cv.percentage,
+    cv.Optional(CONF_HEARTBEAT, default="60s"): cv.positive_time_period_milliseconds,
+})
+
+# Debounces the presence and micromovement binary sensors and on_target_state
+PRESENCE_SCHEMA = cv.Schema({
+    cv.Optional(CONF_ENTER_FRAMES, default=2): cv.int_range(min=1, max=255),
+    # Should outlast a short loss of the target between reports
+    cv.Optional(CONF_HOLD_TIME, default="5s"): cv.positive_time_period_milliseconds,
+    # Targets beyond range are ignored; one already present is kept until range + range_hysteresis
+    cv.Optional(CONF_RANGE): cv.All(cv.distance, cv.float_range(min=0.1, max=10.0)),
+    cv.Optional(CONF_RANGE_HYSTERESIS, default="0.3m"): cv.All(cv.distance, cv.float_range(min=0.0, max=2.0)),
+})
 
 hlk_ld2402_ns = cg.esphome_ns.namespace("hlk_ld2402")
 HLKLD2402Component = hlk_ld2402_ns.class_(
     "HLKLD2402Component", cg.Component, uart.UARTDevice
 )
+AutoGainCompleteTrigger = hlk_ld2402_ns.class_(
+    "AutoGainCompleteTrigger", automation.Trigger.template()
+)
+TargetStateTrigger = hlk_ld2402_ns.class_(
+    "TargetStateTrigger", automation.Trigger.template(cg.std_string)
+)
+
+# Statistic a throttled sensor publishes over the samples seen since its last publish
+Aggregation = hlk_ld2402_ns.enum("Aggregation", is_class=True)
+AGGREGATIONS = {
+    "last": Aggregation.LAST,
+    "min": Aggregation.MIN,
+    "max": Aggregation.MAX,
+    "mean": Aggregation.MEAN,
+    "count": Aggregation.COUNT,
+}
 
 # This makes the component properly visible and available for other platforms
 MULTI_CONF = True
@@ -22,8 +140,42 @@ MULTI_CONF = True
 # Main component schema
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(HLKLD2402Component),
-    cv.Optional(CONF_MAX_DISTANCE, default=5.0): cv.float_range(min=0.7, max=10.0),
-    cv.Optional(CONF_TIMEOUT, default=5): cv.int_range(min=0, max=65535),
+    # Only declared values are reconciled against the device, so no defaults here
+    cv.Optional(CONF_MAX_DISTANCE): cv.float_range(min=0.7, max=10.0),
+    cv.Optional(CONF_TIMEOUT): cv.int_range(min=0, max=65535),
+    # Per-gate thresholds in dB, listed from gate 0 upwards
+    cv.Optional(CONF_MOTION_THRESHOLDS): GATE_THRESHOLDS_SCHEMA,
+    cv.Optional(CONF_MICROMOTION_THRESHOLDS): GATE_THRESHOLDS_SCHEMA,
+    # Quiet period before save_config() requests are written to the module's flash
+    cv.Optional(CONF_SAVE_DELAY, default="5s"): cv.positive_time_period_milliseconds,
+    # Maintenance schedule - jobs that fall due together share one config session
+    cv.Optional(CONF_FIRMWARE_VERSION_DELAY, default="20s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_POWER_INTERFERENCE_DELAY, default="20s"): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_POWER_INTERFERENCE_INTERVAL): cv.positive_time_period_milliseconds,
+    # Progress polling while a calibration runs (1 s and 60 s when not declared)
+    cv.Optional(CONF_CALIBRATION_POLL_INTERVAL): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_CALIBRATION_TIMEOUT): cv.positive_time_period_milliseconds,
+    # Longest silence tolerated before the stream watchdog starts recovery
+    cv.Optional(CONF_STALL_TIMEOUT, default="10s"): cv.positive_time_period_milliseconds,
+    # Engineering frames are evaluated at most this often (2 s when not declared)
+    cv.Optional(CONF_ENGINEERING_THROTTLE): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_ENERGY_DEADBAND): ENERGY_DEADBAND_SCHEMA,
+    # Statistic of each gate's energies over a throttle window (last when not declared)
+    cv.Optional(CONF_ENERGY_AGGREGATION): cv.enum(AGGREGATIONS, lower=True),
+    # Shared by every command sent to the radar
+    cv.Optional(CONF_RETRY): RETRY_SCHEMA,
+    cv.Optional(CONF_CIRCUIT_BREAKER): CIRCUIT_BREAKER_SCHEMA,
+    cv.Optional(CONF_PRESENCE): PRESENCE_SCHEMA,
+    # Fires on every debounced change with state = "none", "moving" or "stationary"
+    cv.Optional(CONF_ON_TARGET_STATE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(TargetStateTrigger),
+    }),
+    # Fires once auto gain has finished and the refreshed thresholds are published
+    cv.Optional(CONF_ON_AUTO_GAIN_COMPLETE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(AutoGainCompleteTrigger),
+    }),
+    # Subsystems used from lambdas, on top of those the configured entities need
+    cv.Optional(CONF_FEATURES, default=[]): cv.ensure_list(cv.one_of(*FEATURE_DEFINES, lower=True)),
 }).extend(cv.COMPONENT_SCHEMA).extend(uart.UART_DEVICE_SCHEMA)
 
 async def to_code(config):
@@ -31,9 +183,60 @@ async def to_code(config):
     await cg.register_component(var, config)
     await uart.register_uart_device(var, config)
     
+    # Sizes the gate tables and limits energy decoding to the configured range. The define is
+    # shared by every radar in the build, so it covers the one with the longest range.
+    cg.add_define("HLK_LD2402_GATES", max(active_gates(radar) for radar in CORE.config[DOMAIN]))
+    for feature in config[CONF_FEATURES]:
+        enable_feature(feature)
     if CONF_MAX_DISTANCE in config:
         cg.add(var.set_max_distance(config[CONF_MAX_DISTANCE]))
     if CONF_TIMEOUT in config:
         cg.add(var.set_timeout(config[CONF_TIMEOUT]))
+    cg.add(var.set_save_delay(config[CONF_SAVE_DELAY]))
+    cg.add(var.set_firmware_version_delay(config[CONF_FIRMWARE_VERSION_DELAY]))
+    cg.add(var.set_power_interference_delay(config[CONF_POWER_INTERFERENCE_DELAY]))
+    if CONF_POWER_INTERFERENCE_INTERVAL in config:
+        cg.add(var.set_power_interference_interval(config[CONF_POWER_INTERFERENCE_INTERVAL]))
+    # Declaring calibration timing implies calibration is used
+    if CONF_CALIBRATION_POLL_INTERVAL in config:
+        enable_feature(FEATURE_CALIBRATION)
+        cg.add(var.set_calibration_poll_interval(config[CONF_CALIBRATION_POLL_INTERVAL]))
+    if CONF_CALIBRATION_TIMEOUT in config:
+        enable_feature(FEATURE_CALIBRATION)
+        cg.add(var.set_calibration_timeout(config[CONF_CALIBRATION_TIMEOUT]))
+    cg.add(var.set_stall_timeout(config[CONF_STALL_TIMEOUT]))
+    # These only apply to gate energies, so declaring them implies engineering
+    if CONF_ENGINEERING_THROTTLE in config:
+        enable_feature(FEATURE_ENGINEERING)
+        cg.add(var.set_engineering_throttle(config[CONF_ENGINEERING_THROTTLE]))
+    if CONF_ENERGY_DEADBAND in config:
+        deadband = config[CONF_ENERGY_DEADBAND]
+        enable_feature(FEATURE_ENGINEERING)
+        cg.add(var.set_energy_deadband(deadband[CONF_ABSOLUTE], deadband[CONF_RELATIVE], deadband[CONF_HEARTBEAT]))
+    if CONF_ENERGY_AGGREGATION in config:
+        enable_feature(FEATURE_ENGINEERING)
+        cg.add(var.set_energy_aggregation(config[CONF_ENERGY_AGGREGATION]))
+    if CONF_RETRY in config:
+        retry = config[CONF_RETRY]
+        cg.add(var.set_retry_policy(retry[CONF_ATTEMPTS], retry[CONF_BASE_DELAY],
+                                    retry[CONF_JITTER], retry[CONF_DEADLINE]))
+    if CONF_CIRCUIT_BREAKER in config:
+        breaker = config[CONF_CIRCUIT_BREAKER]
+        cg.add(var.set_circuit_breaker(breaker[CONF_FAILURE_THRESHOLD], breaker[CONF_COOLDOWN]))
+    for gate, db_value in enumerate(config.get(CONF_MOTION_THRESHOLDS, [])):
+        cg.add(var.set_desired_motion_threshold(gate, db_value))
+    for gate, db_value in enumerate(config.get(CONF_MICROMOTION_THRESHOLDS, [])):
+        cg.add(var.set_desired_micromotion_threshold(gate, db_value))
+    if CONF_PRESENCE in config:
+        presence = config[CONF_PRESENCE]
+        # Distances are configured in metres but compared in centimetres
+        cg.add(var.set_presence_policy(presence[CONF_ENTER_FRAMES], presence[CONF_HOLD_TIME],
+                                       presence.get(CONF_RANGE, 0.0) * 100, presence[CONF_RANGE_HYSTERESIS] * 100))
+    for conf in config.get(CONF_ON_AUTO_GAIN_COMPLETE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [], conf)
+    for conf in config.get(CONF_ON_TARGET_STATE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(cg.std_string, "state")], conf)
 
-# Services are defined in services.yaml file and automatically loaded by ESPHome
\ No newline at end of file
+# Services are defined in services.yaml file and automatically loaded by ESPHome
@@ -9,7 +9,7 @@ from esphome.const import (
     DEVICE_CLASS_PROBLEM,
 )
 
-from . import HLKLD2402Component, CONF_HLK_LD2402_ID
+from . import HLKLD2402Component, CONF_HLK_LD2402_ID, enable_feature, FEATURE_TEXT_PROTOCOL
 
 # Define sensor types
 CONF_POWER_INTERFERENCE = "power_interference"
@@ -29,6 +29,8 @@ async def to_code(config):
     if config.get(CONF_POWER_INTERFERENCE, False):
         cg.add(parent.set_power_interference_binary_sensor(var))
     elif CONF_DEVICE_CLASS in config:
+        # Presence and micromovement follow the distance, which normal mode reports as text lines
+        enable_feature(FEATURE_TEXT_PROTOCOL)
         if config[CONF_DEVICE_CLASS] == DEVICE_CLASS_PRESENCE:
             cg.add(parent.set_presence_binary_sensor(var))
         elif config[CONF_DEVICE_CLASS] == DEVICE_CLASS_MOTION:
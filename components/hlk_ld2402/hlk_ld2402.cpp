@@ -1,11 +1,32 @@
 #include "hlk_ld2402.h"
 #include "esphome/core/log.h"
+#include "esphome/core/helpers.h"
+
+#include <memory>
 
 namespace esphome {
 namespace hlk_ld2402 {
 
 static const char *const TAG = "hlk_ld2402";
 
+const char *target_state_to_string(TargetState state) {
+  switch (state) {
+    case TargetState::MOVING: return "moving";
+    case TargetState::STATIONARY: return "stationary";
+    default: return "none";
+  }
+}
+
+static const char *aggregation_to_string(Aggregation aggregation) {
+  switch (aggregation) {
+    case Aggregation::MIN: return "min";
+    case Aggregation::MAX: return "max";
+    case Aggregation::MEAN: return "mean";
+    case Aggregation::COUNT: return "count";
+    default: return "last";
+  }
+}
+
 void HLKLD2402Component::setup() {
   ESP_LOGCONFIG(TAG, "Setting up HLK-LD2402...");
   
@@ -16,61 +37,18 @@ void HLKLD2402Component::setup() {
   parent->set_data_bits(8);
   parent->set_parity(esphome::uart::UART_CONFIG_PARITY_NONE);
 
-  // Try sending some test data to verify TX functionality
-  write_str("TEST\n");
-  ESP_LOGI(TAG, "Sent test string to verify TX line");
-  delay(500);
-  
-  // Flush any residual data
-  ESP_LOGI(TAG, "Flushing UART");
-  flush();
-  delay(100);
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
-
-  // IMPORTANT ADDITION: Ensure the device starts in normal mode
-  // This prevents issues with leftover engineering mode from previous sessions
-  ESP_LOGI(TAG, "Setting device to normal mode on startup...");
-  
-  // Enter config mode - use multiple attempts as device may be in an inconsistent state
-  bool config_success = false;
-  for (int attempt = 0; attempt < 3; attempt++) {
-    ESP_LOGI(TAG, "Startup config mode attempt %d", attempt + 1);
-    if (enter_config_mode_()) {
-      config_success = true;
-      break;
-    }
-    delay(500);
-  }
-  
-  if (config_success) {
-    // Set work mode to normal
-    if (set_work_mode_(MODE_NORMAL)) {
-      ESP_LOGI(TAG, "Successfully initialized device to normal mode");
-    } else {
-      ESP_LOGW(TAG, "Failed to set normal mode, but continuing with initialization");
-    }
-    
-    // Always exit config mode
-    exit_config_mode_();
-    delay(200);
-  } else {
-    ESP_LOGW(TAG, "Failed to enter config mode to initialize normal mode, continuing anyway");
-  }
-
-  // Initialize but don't touch the device if we don't need to
-  // The logs show the device is already sending data correctly
-  // Skip configuration and just set up sensors
-  ESP_LOGI(TAG, "LD2402 appears to be sending data already. Skipping additional configuration.");
-  ESP_LOGI(TAG, "Use the Engineering Mode button if you need to modify settings.");
-  
-  // Don't check power interference immediately - use a delayed operation
-  ESP_LOGI(TAG, "Will check power interference and firmware version after 60 seconds");
-  
-  // Remove the immediate firmware version check - it will happen after 60 seconds
-  // get_firmware_version_();
+  // Nothing here talks to the radar. Normalisation (and reconciliation of declared
+  // parameters) runs from loop() once we've listened to what the module is sending.
+  startup_state_ = StartupState::LISTENING;
+  startup_started_at_ = millis();
+  
+  // Deferred maintenance: both jobs share one config session when they fall due together
+  power_interference_task_ = maintenance_task_count_;
+  add_maintenance_task_("power interference", 10, power_interference_delay_ms_, power_interference_interval_ms_,
+                        std::min(power_interference_interval_ms_ / 10, MAX_MAINTENANCE_JITTER_MS), true,
+                        [this](std::function<void()> done) { queue_power_interference_read_(std::move(done)); });
+  add_maintenance_task_("firmware version", 5, firmware_version_delay_ms_, 0, 0, true,
+                        [this](std::function<void()> done) { queue_firmware_version_read_(std::move(done)); });
   
   // Set a default version - this will be displayed until we can determine the actual version
   if (firmware_version_text_sensor_ != nullptr) {
@@ -83,11 +61,202 @@ void HLKLD2402Component::setup() {
   // Set initial operating mode text
   operating_mode_ = "Normal";
   publish_operating_mode_();
+  publish_stream_health_();
+  
+  register_data_frame_handler_(DATA_FRAME_TYPE_DISTANCE, StreamMode::NORMAL, "distance", DATA_FRAME_PAYLOAD_OFFSET,
+                               &HLKLD2402Component::process_distance_frame_);
+#ifdef USE_HLK_LD2402_ENGINEERING
+  // In engineering mode the module reports per-gate energies in 0x83 frames too
+  register_data_frame_handler_(DATA_FRAME_TYPE_DISTANCE, StreamMode::ENGINEERING, "energy (0x83)",
+                               ENGINEERING_MIN_FRAME, &HLKLD2402Component::process_engineering_from_distance_frame_);
+#endif
+  register_notification_handler_(CMD_AUTO_GAIN_COMPLETE,
+                                 [this](const std::vector<uint8_t> &frame) { handle_auto_gain_complete_(frame); });
   
   // Initialize the throttle timestamp to avoid updates right after boot
   last_distance_update_ = millis();
 }
 
+// Background part of startup: skip normalisation if the module is already streaming,
+// otherwise force normal mode. Either way declared parameters get reconciled.
+void HLKLD2402Component::run_startup_() {
+  if (startup_state_ != StartupState::LISTENING)
+    return;
+  
+  if (measurement_seen_) {
+    ESP_LOGI(TAG, "Radar is already streaming measurements, skipping normalisation");
+    if (desired_mask_ != 0) {
+      start_startup_session_(false);
+    } else {
+      startup_state_ = StartupState::DONE;
+    }
+    return;
+  }
+  
+  if (millis() - startup_started_at_ < STARTUP_LISTEN_MS)
+    return;
+  
+  ESP_LOGI(TAG, "No measurement output after %u ms, setting device to normal mode", STARTUP_LISTEN_MS);
+  start_startup_session_(true);
+}
+
+void HLKLD2402Component::start_startup_session_(bool normalise) {
+  startup_state_ = StartupState::NORMALISING;
+  
+  // Config entry is retried by the command engine's retry policy
+  queue_enter_config_([this, normalise](bool entered) {
+    if (!entered) {
+      ESP_LOGW(TAG, "Failed to enter config mode at startup, continuing anyway");
+      startup_state_ = StartupState::DONE;
+      return;
+    }
+    
+    auto reconcile = [this]() { reconcile_parameters_([this]() { finish_startup_session_(); }); };
+    if (!normalise) {
+      reconcile();
+      return;
+    }
+    
+    queue_command_(CMD_SET_MODE, {MODE_NORMAL}, [this, reconcile](const CommandResult &result, const std::vector<uint8_t> &payload) {
+      if (result.ok()) {
+        ESP_LOGI(TAG, "Successfully initialized device to normal mode");
+      } else {
+        ESP_LOGW(TAG, "Failed to set normal mode, but continuing with initialization");
+      }
+      reconcile();
+    });
+  });
+}
+
+void HLKLD2402Component::finish_startup_session_() {
+  queue_exit_config_([this]() {
+    startup_state_ = StartupState::DONE;
+    ESP_LOGI(TAG, "Startup sequence complete");
+  });
+}
+
+void HLKLD2402Component::queue_enter_config_(std::function<void(bool)> &&done) {
+  auto done_ptr = std::make_shared<std::function<void(bool)>>(std::move(done));
+  queue_command_(CMD_ENABLE_CONFIG, {}, [this, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+    bool entered = result.ok();
+    if (entered) {
+      config_mode_ = true;
+      operating_mode_ = "Config";
+      publish_operating_mode_();
+    }
+    (*done_ptr)(entered);
+  });
+}
+
+void HLKLD2402Component::queue_exit_config_(std::function<void()> &&done) {
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  queue_command_(CMD_DISABLE_CONFIG, {}, [this, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+    // Some firmware versions don't answer the exit command, so leave regardless
+    config_mode_ = false;
+    publish_command_stats_();
+    if (operating_mode_ == "Config") {
+      operating_mode_ = "Normal";
+      publish_operating_mode_();
+    }
+    (*done_ptr)();
+  });
+}
+
+void HLKLD2402Component::add_maintenance_task_(const char *name, uint8_t priority, uint32_t first_delay_ms,
+                                               uint32_t interval_ms, uint32_t jitter_ms, bool needs_config,
+                                               MaintenanceJob &&run) {
+  if (maintenance_task_count_ >= MAX_MAINTENANCE_TASKS) {
+    ESP_LOGE(TAG, "Too many maintenance tasks, dropping '%s'", name);
+    return;
+  }
+  MaintenanceTask &task = maintenance_tasks_[maintenance_task_count_++];
+  task.name = name;
+  task.priority = priority;
+  task.interval_ms = interval_ms;
+  task.jitter_ms = jitter_ms;
+  task.next_run = millis() + first_delay_ms;
+  task.needs_config = needs_config;
+  task.enabled = true;
+  task.run = std::move(run);
+}
+
+void HLKLD2402Component::reschedule_task_(MaintenanceTask &task) {
+  if (task.interval_ms == 0) {
+    task.enabled = false;
+    return;
+  }
+  uint32_t jitter = task.jitter_ms > 0 ? random_uint32() % task.jitter_ms : 0;
+  task.next_run = millis() + task.interval_ms + jitter;
+}
+
+// Runs all due tasks, highest priority first. Tasks needing config mode are
+// bracketed by a single enter/exit pair instead of one session each.
+void HLKLD2402Component::run_scheduler_() {
+  if (maintenance_running_ || startup_state_ != StartupState::DONE || config_mode_ ||
+      calibration_in_progress_ || command_queue_busy_() || breaker_open_())
+    return;
+  
+  uint32_t now = millis();
+  // Entering config mode would interrupt an engineering capture
+  bool capture_active = operating_mode_ == "Engineering";
+  std::vector<MaintenanceTask *> config_tasks;
+  std::vector<MaintenanceTask *> plain_tasks;
+  for (uint8_t i = 0; i < maintenance_task_count_; i++) {
+    MaintenanceTask &task = maintenance_tasks_[i];
+    if (!task.enabled || static_cast<int32_t>(now - task.next_run) < 0)
+      continue;
+    if (task.needs_config && capture_active) {
+      // Periodic work skips this round, one-shot work waits for the capture to end
+      if (task.interval_ms > 0) {
+        ESP_LOGD(TAG, "Skipping maintenance '%s' during engineering capture", task.name);
+        reschedule_task_(task);
+      }
+      continue;
+    }
+    (task.needs_config ? config_tasks : plain_tasks).push_back(&task);
+  }
+  if (config_tasks.empty() && plain_tasks.empty())
+    return;
+  
+  auto by_priority = [](const MaintenanceTask *a, const MaintenanceTask *b) { return a->priority > b->priority; };
+  std::sort(config_tasks.begin(), config_tasks.end(), by_priority);
+  std::sort(plain_tasks.begin(), plain_tasks.end(), by_priority);
+  
+  maintenance_running_ = true;
+  run_maintenance_batch_(plain_tasks, 0, [this, config_tasks]() {
+    if (config_tasks.empty()) {
+      maintenance_running_ = false;
+      return;
+    }
+    queue_enter_config_([this, config_tasks](bool entered) {
+      if (!entered) {
+        // Try again on the next interval rather than hammering the module
+        ESP_LOGW(TAG, "Failed to enter config mode for maintenance, postponing %zu task(s)", config_tasks.size());
+        for (MaintenanceTask *task : config_tasks) {
+          reschedule_task_(*task);
+        }
+        maintenance_running_ = false;
+        return;
+      }
+      run_maintenance_batch_(config_tasks, 0, [this]() {
+        queue_exit_config_([this]() { maintenance_running_ = false; });
+      });
+    });
+  });
+}
+
+void HLKLD2402Component::run_maintenance_batch_(std::vector<MaintenanceTask *> tasks, size_t index,
+                                                std::function<void()> done) {
+  if (index >= tasks.size()) {
+    done();
+    return;
+  }
+  MaintenanceTask *task = tasks[index];
+  ESP_LOGI(TAG, "Running maintenance task: %s", task->name);
+  reschedule_task_(*task);
+  task->run([this, tasks, index, done]() { run_maintenance_batch_(tasks, index + 1, done); });
+}
+
 // New function to passively monitor output for version info
 void HLKLD2402Component::begin_passive_version_detection_() {
   ESP_LOGI(TAG, "Starting passive version detection");
@@ -102,122 +271,447 @@ void HLKLD2402Component::publish_operating_mode_() {
   }
 }
 
-// Update get_firmware_version_ method to use correct command and parsing
-void HLKLD2402Component::get_firmware_version_() {
-  ESP_LOGI(TAG, "Retrieving firmware version...");
+// Reads the firmware version (protocol 5.2.1) on the async queue; needs config mode
+void HLKLD2402Component::queue_firmware_version_read_(std::function<void()> &&done) {
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  queue_command_(CMD_GET_VERSION, {}, [this, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+    const char *failure = nullptr;
+    if (result.error == CommandError::TIMEOUT) {
+      failure = "No Response";
+    } else if (!result.ok() || payload.empty()) {
+      failure = "Invalid Response";
+    } else {
+      firmware_version_.assign(payload.begin(), payload.end());
+      ESP_LOGI(TAG, "Got firmware version: %s", firmware_version_.c_str());
+      if (firmware_version_text_sensor_ != nullptr) {
+        firmware_version_text_sensor_->publish_state(firmware_version_);
+      }
+    }
+    
+    if (failure != nullptr) {
+      ESP_LOGW(TAG, "Firmware version read failed: %s", failure);
+      if (firmware_version_text_sensor_ != nullptr) {
+        firmware_version_text_sensor_->publish_state(failure);
+      }
+    }
+    (*done_ptr)();
+  });
+}
+
+// Reads parameter 0x0005 on the async queue; needs config mode
+void HLKLD2402Component::queue_power_interference_read_(std::function<void()> &&done) {
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  queue_command_(CMD_GET_PARAMS, {PARAM_POWER_INTERFERENCE},
+                 [this, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+    // A failed read is reported as unknown, never as interference
+    PowerInterferenceState state = PowerInterferenceState::UNKNOWN;
+    if (!result.ok()) {
+      ESP_LOGW(TAG, "Power interference parameter query failed: %s", result.describe());
+    } else {
+      uint32_t value = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (payload[3] << 24);
+      switch (value) {
+        case 0: state = PowerInterferenceState::NOT_PERFORMED; break;
+        case 1: state = PowerInterferenceState::NONE; break;
+        case 2: state = PowerInterferenceState::DETECTED; break;
+        default: ESP_LOGW(TAG, "Unknown power interference value: %u", value); break;
+      }
+    }
+    publish_power_interference_(state);
+    (*done_ptr)();
+  });
+}
+
+void HLKLD2402Component::publish_power_interference_(PowerInterferenceState state) {
+  if (power_interference_published_ && state == power_interference_state_)
+    return;
+  power_interference_state_ = state;
+  power_interference_published_ = true;
+  
+  const char *text = "Unknown";
+  switch (state) {
+    case PowerInterferenceState::NOT_PERFORMED: text = "Not Performed"; break;
+    case PowerInterferenceState::NONE: text = "None"; break;
+    case PowerInterferenceState::DETECTED: text = "Detected"; break;
+    default: break;
+  }
+  ESP_LOGI(TAG, "Power interference: %s", text);
   
-  // Clear any pending data
-  flush();
+  if (power_interference_text_sensor_ != nullptr) {
+    power_interference_text_sensor_->publish_state(text);
+  }
+  // The binary sensor keeps its last real reading when the check fails
+  if (power_interference_binary_sensor_ != nullptr && state != PowerInterferenceState::UNKNOWN) {
+    power_interference_detected_ = state == PowerInterferenceState::DETECTED;
+    power_interference_binary_sensor_->publish_state(power_interference_detected_);
+  }
+}
+
+// The single byte pump. Everything read from the UART goes through feed_byte_(),
+// both from loop() and while a blocking helper waits for its ACK.
+void HLKLD2402Component::pump_uart_() {
   while (available()) {
     uint8_t c;
     read_byte(&c);
+    last_byte_time_ = millis();
+    status_byte_count_++;
+    
+    // Record last bytes for diagnostics
+    last_bytes_[last_byte_pos_] = c;
+    last_byte_pos_ = (last_byte_pos_ + 1) % sizeof(last_bytes_);
+    
+    feed_byte_(c);
   }
-  
-  bool entered_config_mode = false;
-  
-  if (!config_mode_) {
-    if (!enter_config_mode_()) {
-      ESP_LOGW(TAG, "Failed to enter config mode for firmware version check");
-      if (firmware_version_text_sensor_ != nullptr) {
-        firmware_version_text_sensor_->publish_state("Unknown - Config Failed");
+}
+
+// Demultiplexes the stream into command frames (FD FC FB FA ... 04 03 02 01),
+// data frames (F4 F3 F2 F1 ... F8 F7 F6 F5) and text lines.
+void HLKLD2402Component::feed_byte_(uint8_t c) {
+  switch (demux_state_) {
+    case DemuxState::COMMAND_FRAME: {
+      frame_buffer_.push_back(c);
+      if (frame_buffer_.size() < 2)
+        return;
+      // Length word counts the bytes between itself and the footer
+      size_t expected = 2 + (frame_buffer_[0] | (frame_buffer_[1] << 8)) + 4;
+      if (expected > MAX_COMMAND_FRAME_SIZE) {
+        ESP_LOGW(TAG, "Implausible command frame length, resyncing");
+        demux_state_ = DemuxState::TEXT;
+        note_desync_();
+        return;
+      }
+      if (frame_buffer_.size() < expected)
+        return;
+      demux_state_ = DemuxState::TEXT;
+      if (memcmp(&frame_buffer_[expected - 4], FRAME_FOOTER, 4) != 0) {
+        ESP_LOGW(TAG, "Command frame footer mismatch, dropping frame");
+        note_desync_();
+        return;
+      }
+      frame_buffer_.resize(expected - 4);
+      route_command_frame_(frame_buffer_);
+      return;
+    }
+    
+    case DemuxState::DATA_FRAME: {
+      frame_buffer_.push_back(c);
+      if (frame_buffer_.size() < DATA_FRAME_STATUS_OFFSET)
+        return;
+      // Framed by the length word like command frames; energies may contain the footer bytes
+      size_t expected = DATA_FRAME_STATUS_OFFSET +
+                        (frame_buffer_[DATA_FRAME_LENGTH_OFFSET] | (frame_buffer_[DATA_FRAME_LENGTH_OFFSET + 1] << 8)) + 4;
+      if (expected > MAX_DATA_FRAME_SIZE) {
+        ESP_LOGW(TAG, "Implausible data frame length, resyncing");
+        demux_state_ = DemuxState::TEXT;
+        note_desync_();
+        return;
       }
+      if (frame_buffer_.size() < expected)
+        return;
+      demux_state_ = DemuxState::TEXT;
+      if (memcmp(&frame_buffer_[expected - 4], DATA_FRAME_FOOTER, 4) != 0) {
+        ESP_LOGW(TAG, "Data frame footer mismatch after %zu bytes, dropping frame", expected);
+        note_desync_();
+        return;
+      }
+      frame_buffer_.resize(expected - 4);
+      dispatch_data_frame_(frame_buffer_);
       return;
     }
-    entered_config_mode = true;
+    
+    case DemuxState::TEXT:
+      break;
   }
   
-  // Per protocol spec 5.2.1 - use command 0x0000 for firmware version
-  if (send_command_(CMD_GET_VERSION)) {
-    delay(300);
-    
-    std::vector<uint8_t> response;
-    if (read_response_(response, 1000)) {
-      // According to the protocol, response format: 
-      // version_length (2 bytes) + version_string (N bytes)
-      if (response.size() >= 2) {
-        uint16_t version_length = response[0] | (response[1] << 8);
-        
-        if (response.size() >= 2 + version_length && version_length > 0) {
-          std::string version;
-          // Extract version string
-          for (size_t i = 2; i < 2 + version_length; i++) {
-            version += (char)response[i];
+  header_window_ = (header_window_ << 8) | c;
+  bool command_header = header_window_ == COMMAND_HEADER_WORD;
+  bool data_header = header_window_ == DATA_HEADER_WORD;
+  if (command_header || data_header) {
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
+    // The first three header bytes already went to the line buffer
+    line_buffer_.resize(line_buffer_.size() - std::min(line_buffer_.size(), size_t(3)));
+#endif
+    header_window_ = 0;
+    frame_buffer_.clear();
+    if (command_header) {
+      demux_state_ = DemuxState::COMMAND_FRAME;
+    } else {
+      demux_state_ = DemuxState::DATA_FRAME;
+      frame_buffer_.insert(frame_buffer_.end(), DATA_FRAME_HEADER, DATA_FRAME_HEADER + 4);
+    }
+    return;
+  }
+  
+  handle_text_byte_(c);
+}
+
+// ACKs go to whoever sent the command, matched on the echoed command word
+void HLKLD2402Component::route_command_frame_(const std::vector<uint8_t> &frame) {
+  if (frame.size() < 4) {
+    ESP_LOGW(TAG, "Command frame too short: %zu bytes", frame.size());
+    return;
+  }
+  // ACKs echo the command with bit 8 set; notifications carry the bare command
+  uint16_t command = (frame[2] | (frame[3] << 8)) & ~0x0100;
+  
+  const CommandDescriptor *desc = find_command(command);
+  if (desc != nullptr && desc->ack != AckLayout::NOTIFICATION && command == last_sent_command_) {
+    record_latency_(*desc, millis() - command_sent_at_, last_sent_units_);
+  }
+  
+  if (awaiting_response_ && command == awaited_command_) {
+    awaited_response_ = frame;
+    response_ready_ = true;
+    return;
+  }
+  
+  if (command_in_flight_ && command == command_queue_.front().desc->opcode) {
+    QueuedCommand &front = command_queue_.front();
+    std::vector<uint8_t> payload;
+    CommandResult result = decode_ack_(*front.desc, front.arg_count, frame, payload);
+    result.elapsed_ms = millis() - front.started_at;
+    record_outcome_(*front.desc, result);
+    complete_queued_(result, payload);
+    return;
+  }
+  
+  if (dispatch_notification_(command, frame))
+    return;
+  
+  unhandled_notifications_++;
+  ESP_LOGD(TAG, "Unsolicited command frame 0x%04X (%zu bytes)", command, frame.size());
+}
+
+void HLKLD2402Component::register_notification_handler_(uint16_t opcode, NotificationHandler &&handler) {
+  if (opcode >= NOTIFICATION_OPCODE_LIMIT || notification_handler_count_ >= MAX_NOTIFICATION_HANDLERS) {
+    ESP_LOGE(TAG, "Cannot register a handler for notification 0x%04X", opcode);
+    return;
+  }
+  notification_handlers_[notification_handler_count_] = std::move(handler);
+  notification_slots_[opcode] = ++notification_handler_count_;
+}
+
+bool HLKLD2402Component::dispatch_notification_(uint16_t opcode, const std::vector<uint8_t> &frame) {
+  if (opcode >= NOTIFICATION_OPCODE_LIMIT || notification_slots_[opcode] == 0)
+    return false;
+  notification_handlers_[notification_slots_[opcode] - 1](frame);
+  return true;
+}
+
+void HLKLD2402Component::register_data_frame_handler_(uint8_t type, StreamMode mode, const char *name,
+                                                      size_t min_size, DataFrameHandlerFn handle) {
+  uint8_t index = type - DATA_FRAME_TYPE_BASE;
+  if (type < DATA_FRAME_TYPE_BASE || index >= DATA_FRAME_TYPE_SLOTS ||
+      data_handler_count_ >= MAX_DATA_FRAME_HANDLERS) {
+    ESP_LOGE(TAG, "Cannot register a handler for data frame type 0x%02X", type);
+    return;
+  }
+  DataFrameHandler &handler = data_handlers_[data_handler_count_];
+  handler = DataFrameHandler{};
+  handler.name = name;
+  handler.min_size = std::max(min_size, DATA_FRAME_STATUS_OFFSET);
+  handler.handle = handle;
+  data_handler_slots_[index][static_cast<uint8_t>(mode)] = ++data_handler_count_;
+}
+
+void HLKLD2402Component::dispatch_data_frame_(const std::vector<uint8_t> &frame_data) {
+  if (frame_data.size() < DATA_FRAME_STATUS_OFFSET) {
+    short_data_frames_++;
+    return;
+  }
+  note_stream_unit_();
+  // Any complete data frame shows the module is streaming, even one from an empty room
+  measurement_seen_ = true;
+  
+  DataFrameView frame{frame_data.data(), frame_data.size()};
+  uint8_t index = frame.type() - DATA_FRAME_TYPE_BASE;
+  if (frame.type() < DATA_FRAME_TYPE_BASE || index >= DATA_FRAME_TYPE_SLOTS) {
+    unknown_frame_types_++;
+    return;
+  }
+  uint8_t slot = data_handler_slots_[index][static_cast<uint8_t>(stream_mode_())];
+  if (slot == 0) {
+    bool known = false;
+    for (uint8_t mode = 0; mode < STREAM_MODE_COUNT; mode++) {
+      known |= data_handler_slots_[index][mode] != 0;
+    }
+    if (known) {
+      unhandled_data_frames_++;
+    } else {
+      unknown_frame_types_++;
+    }
+    return;
+  }
+  
+  DataFrameHandler &handler = data_handlers_[slot - 1];
+  handler.frames++;
+  if (frame.size() < handler.min_size) {
+    short_data_frames_++;
+    handler.failures++;
+    return;
+  }
+  
+  uint32_t start = micros();
+  bool handled = (this->*handler.handle)(frame);
+  uint32_t elapsed = micros() - start;
+  handler.total_us += elapsed;
+  handler.max_us = std::max(handler.max_us, elapsed);
+  if (!handled) {
+    handler.failures++;
+  }
+}
+
+void HLKLD2402Component::log_data_frame_stats_() {
+  for (uint8_t i = 0; i < data_handler_count_; i++) {
+    const DataFrameHandler &handler = data_handlers_[i];
+    if (handler.frames == 0)
+      continue;
+    ESP_LOGD(TAG, "Frames '%s': %u (%u failed), decode avg %u us, max %u us", handler.name, handler.frames,
+             handler.failures, handler.total_us / handler.frames, handler.max_us);
+  }
+  if (unknown_frame_types_ > 0 || unhandled_data_frames_ > 0 || short_data_frames_ > 0) {
+    ESP_LOGD(TAG, "Frames skipped: %u unknown layout, %u not handled in this mode, %u too short",
+             unknown_frame_types_, unhandled_data_frames_, short_data_frames_);
+  }
+}
+
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
+void HLKLD2402Component::handle_text_byte_(uint8_t c) {
+  // Check for text data - add to line buffer
+  if (c == '\n') {
+    // Process complete line
+    if (!line_buffer_.empty()) {
+      note_stream_unit_();
+      
+      // Startup only needs to know the module is streaming
+      if (!measurement_seen_ && (line_buffer_ == "OFF" || line_buffer_.find("distance:") != std::string::npos)) {
+        measurement_seen_ = true;
+      }
+      
+      // Every line is parsed so the distance window and presence see all samples; the
+      // sensors throttle their own publishes, only the log line is rate limited here
+      bool log_line = millis() - last_line_log_time_ >= LINE_LOG_INTERVAL_MS;
+      if (log_line)
+        last_line_log_time_ = millis();
+      
+      // Less restrictive binary check - only look for obviously non-text chars
+      bool is_binary = false;
+      for (char ch : line_buffer_) {
+        // Only consider control chars below space as binary (except tab and CR)
+        if (ch < 32 && ch != '\t' && ch != '\r' && ch != '\n') {
+          // Count actual binary characters
+          int binary_count = 0;
+          for (char c2 : line_buffer_) {
+            if (c2 < 32 && c2 != '\t' && c2 != '\r' && c2 != '\n') {
+              binary_count++;
+            }
           }
           
-          firmware_version_ = version;
-          ESP_LOGI(TAG, "Got firmware version: %s", version.c_str());
-          
-          if (firmware_version_text_sensor_ != nullptr) {
-            firmware_version_text_sensor_->publish_state(version);
-            ESP_LOGI(TAG, "Published firmware version: %s", version.c_str());
-          }
-        } else {
-          ESP_LOGW(TAG, "Invalid version string length in response");
-          if (firmware_version_text_sensor_ != nullptr) {
-            firmware_version_text_sensor_->publish_state("Invalid Response");
+          // Only mark as binary if we have several binary chars (>25%)
+          if (binary_count > line_buffer_.length() / 4) {
+            is_binary = true;
+            break;
           }
         }
+      }
+      
+      if (log_line) {
+        ESP_LOGI(TAG, "Received line [%zu bytes]: '%s'", line_buffer_.length(), line_buffer_.c_str());
       } else {
-        ESP_LOGW(TAG, "Response too short for version data");
-        if (firmware_version_text_sensor_ != nullptr) {
-          firmware_version_text_sensor_->publish_state("Invalid Response Format");
-        }
+        ESP_LOGV(TAG, "Received line [%zu bytes]: '%s'", line_buffer_.length(), line_buffer_.c_str());
       }
-    } else {
-      ESP_LOGW(TAG, "No response to version command");
-      if (firmware_version_text_sensor_ != nullptr) {
-        firmware_version_text_sensor_->publish_state("No Response");
+      if (!is_binary) {
+        process_line_(line_buffer_);
+      } else {
+        ESP_LOGD(TAG, "Skipped binary data that looks like a protocol frame");
+        
+        // Debug: Show hex representation of binary data
+        char hex_buf[128] = {0};
+        for (size_t i = 0; i < std::min(line_buffer_.length(), size_t(32)); i++) {
+          sprintf(hex_buf + (i*3), "%02X ", (uint8_t)line_buffer_[i]);
+        }
+        ESP_LOGD(TAG, "Binary data hex: %s", hex_buf);
       }
+      line_buffer_.clear();
     }
-  } else {
-    ESP_LOGW(TAG, "Failed to send version command");
-    if (firmware_version_text_sensor_ != nullptr) {
-      firmware_version_text_sensor_->publish_state("Command Failed");
+  } else if (c != '\r') {  // Skip \r
+    if (line_buffer_.length() < 1024) {
+      line_buffer_ += (char)c;
+      
+      // Added: Check for direct "distance:" line without proper termination
+      if (line_buffer_.length() >= 12 && 
+          line_buffer_.compare(line_buffer_.length() - 12, 9, "distance:") == 0) {
+        // We found a distance prefix - process the previous data if any
+        std::string prev_data = line_buffer_.substr(0, line_buffer_.length() - 12);
+        if (!prev_data.empty()) {
+          ESP_LOGI(TAG, "Found distance prefix, processing previous data: '%s'", prev_data.c_str());
+          process_line_(prev_data);
+        }
+        // Keep only the distance part
+        line_buffer_ = line_buffer_.substr(line_buffer_.length() - 12);
+      }
+    } else {
+      ESP_LOGW(TAG, "Line buffer overflow, clearing");
+      line_buffer_.clear();
     }
   }
   
-  // Exit config mode if we entered it
-  if (entered_config_mode) {
-    exit_config_mode_();
+  // Additional processing in loop to passively detect version info
+  // from normal operation output, even after initial check
+  if (!firmware_version_.empty() && firmware_version_ != "Unknown" && 
+      firmware_version_.find("HLK-LD2402") == 0 && 
+      firmware_version_.find("v") == std::string::npos) {
+    
+    // We only have model info, still looking for version number
+    if (c == '\n' && !line_buffer_.empty()) {
+      if (line_buffer_.find("v") != std::string::npos || 
+          line_buffer_.find("V") != std::string::npos ||
+          line_buffer_.find("version") != std::string::npos ||
+          line_buffer_.find("Version") != std::string::npos) {
+        
+        ESP_LOGI(TAG, "Found potential version info: %s", line_buffer_.c_str());
+        // Extract version information
+        std::string version = "HLK-LD2402";
+        
+        // Try to find version number pattern
+        for (size_t i = 0; i < line_buffer_.length(); i++) {
+          if ((i+2 < line_buffer_.length() && 
+              isdigit(line_buffer_[i]) && 
+              line_buffer_[i+1] == '.' && 
+              isdigit(line_buffer_[i+2])) ||
+              (line_buffer_[i] == 'v' || line_buffer_[i] == 'V')) {
+            
+            size_t start_pos = line_buffer_[i] == 'v' || line_buffer_[i] == 'V' ? i+1 : i;
+            size_t end_pos = line_buffer_.find_first_not_of("0123456789.", start_pos);
+            if (end_pos == std::string::npos) end_pos = line_buffer_.length();
+            
+            version = "v" + line_buffer_.substr(start_pos, end_pos - start_pos);
+            firmware_version_ = version;
+            
+            if (firmware_version_text_sensor_ != nullptr) {
+              firmware_version_text_sensor_->publish_state(version);
+              ESP_LOGI(TAG, "Updated firmware version from passive detection: %s", version.c_str());
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+#else
+// Text lines aren't parsed in this build, but they still show the module is streaming
+void HLKLD2402Component::handle_text_byte_(uint8_t c) {
+  // Lines aren't parsed, but a streaming module must not be normalised at startup
+  if (c == '\n') {
+    note_stream_unit_();
+    measurement_seen_ = true;
   }
 }
+#endif
 
 void HLKLD2402Component::loop() {
-  static uint32_t last_byte_time = 0;
-  static uint32_t last_process_time = 0; // Add throttling timer
-  static const uint32_t PROCESS_INTERVAL = 2000; // Only process lines every 2 seconds
-  static const uint32_t TIMEOUT_MS = 100; // Reset buffer if no data for 100ms
   static uint32_t last_debug_time = 0;
-  static uint8_t raw_buffer[16];
-  static size_t raw_pos = 0;
   static uint32_t last_status_time = 0;
-  static uint32_t byte_count = 0;
-  static uint8_t last_bytes[16] = {0};
-  static size_t last_byte_pos = 0;
-  static bool firmware_check_done = false;
-  static bool power_check_done = false;
-  static uint32_t startup_time = millis();
-  static uint32_t last_eng_debug_time = 0;
-  static uint32_t eng_mode_start_time = 0;
-  static uint32_t last_eng_retry_time = 0;
-  static uint8_t eng_retry_count = 0;
-  static uint32_t firmware_check_time = 0;  // New variable to track when firmware check completes
-  
-  // Firmware version check earlier at 20 seconds to avoid conflict with power check
-  if (!firmware_check_done && (millis() - startup_time) > 20000) {
-    ESP_LOGI(TAG, "Performing firmware version check...");
-    get_firmware_version_();
-    firmware_check_done = true;
-    firmware_check_time = millis();  // Record when firmware check completes
-  }
-  
-  // Power interference check 3 seconds after firmware check completes
-  if (firmware_check_done && !power_check_done && 
-      firmware_check_time > 0 && (millis() - firmware_check_time) > 3000) {
-    ESP_LOGI(TAG, "Performing power interference check...");
-    check_power_interference();
-    power_check_done = true;
-  }
   
   // Add periodic debug message - reduce frequency
   if (millis() - last_debug_time > 30000) {  // Every 30 seconds
@@ -227,475 +721,82 @@ void HLKLD2402Component::loop() {
   
   // Every 10 seconds, report status
   if (millis() - last_status_time > 10000) {
-    ESP_LOGI(TAG, "Status: received %u bytes in last 10 seconds", byte_count);
-    if (byte_count > 0) {
+    ESP_LOGI(TAG, "Status: received %u bytes in last 10 seconds", status_byte_count_);
+    if (status_byte_count_ > 0) {
       char hex_buf[50] = {0};
       char ascii_buf[20] = {0};
-      for (int i = 0; i < 16 && i < byte_count; i++) {
-        sprintf(hex_buf + (i*3), "%02X ", last_bytes[i]);
-        sprintf(ascii_buf + i, "%c", (last_bytes[i] >= 32 && last_bytes[i] < 127) ? last_bytes[i] : '.');
+      for (int i = 0; i < 16 && i < status_byte_count_; i++) {
+        sprintf(hex_buf + (i*3), "%02X ", last_bytes_[i]);
+        sprintf(ascii_buf + i, "%c", (last_bytes_[i] >= 32 && last_bytes_[i] < 127) ? last_bytes_[i] : '.');
       }
       ESP_LOGI(TAG, "Last bytes (hex): %s", hex_buf);
       ESP_LOGI(TAG, "Last bytes (ascii): %s", ascii_buf);
     }
-    byte_count = 0;
+    log_data_frame_stats_();
+    status_byte_count_ = 0;
     last_status_time = millis();
   }
   
+#ifdef USE_HLK_LD2402_ENGINEERING
+  static uint32_t last_eng_debug_time = 0;
   // Add this at the beginning of the loop method
   if (operating_mode_ == "Engineering" && (millis() - last_eng_debug_time) > 5000) {
     ESP_LOGI(TAG, "Currently in engineering mode, waiting for data frames. Data enabled: %s, Sensors configured: %d",
-             engineering_data_enabled_ ? "YES" : "NO", energy_gate_sensors_.size());
+             engineering_data_enabled_ ? "YES" : "NO", energy_gate_sensors_.count());
     last_eng_debug_time = millis();
   }
   
-  // If we're in engineering mode, monitor if we're receiving data
-  if (operating_mode_ == "Engineering") {
-    uint32_t now = millis();
-    
-    // Set the start time if not set
-    if (eng_mode_start_time == 0) {
-      eng_mode_start_time = now;
-    }
-    
-    // Check if we're getting data in engineering mode
-    if ((now - last_status_time > 10000) && byte_count == 0) {
-      // No bytes received in 10 seconds while in engineering mode
-      if (now - last_eng_retry_time > 15000 && eng_retry_count < 3) {
-        // Try re-triggering engineering mode data every 15 seconds, up to 3 times
-        ESP_LOGW(TAG, "No data received in engineering mode - attempting to re-trigger data flow (attempt %d/3)", 
-                eng_retry_count + 1);
-        
-        // Send a parameter read command which might trigger data flow
-        uint8_t param_data[2];
-        param_data[0] = 0x01;  // Max distance parameter
-        param_data[1] = 0x00;
-        send_command_(CMD_GET_PARAMS, param_data, sizeof(param_data));
-        
-        // Increment retry counter and update timestamp
-        eng_retry_count++;
-        last_eng_retry_time = now;
-      }
-      else if (eng_retry_count >= 3 && now - eng_mode_start_time > 60000) {
-        // If we've been in engineering mode for over a minute with no data after 3 retries
-        ESP_LOGW(TAG, "Engineering mode not producing data frames after multiple retries. Try power cycling the device.");
-      }
-    }
-    else if (byte_count > 0) {
-      // Reset retry counter if we got data
-      eng_retry_count = 0;
-    }
-  }
-  else {
-    // Reset engineering mode tracking variables when not in engineering mode
-    eng_mode_start_time = 0;
-    eng_retry_count = 0;
-    last_eng_retry_time = 0;
-  }
-  
   // Add this at the beginning of the loop method for additional safety
   if (operating_mode_ != "Engineering" && engineering_data_enabled_) {
     ESP_LOGI(TAG, "Detected inconsistent state: engineering data enabled but not in engineering mode. Fixing...");
     engineering_data_enabled_ = false;
   }
+#endif
   
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-    last_byte_time = millis();
-    byte_count++;
-    
-    // Record last bytes for diagnostics
-    last_bytes[last_byte_pos] = c;
-    last_byte_pos = (last_byte_pos + 1) % 16;
-    
-    // Debug: Collect raw data
-    raw_buffer[raw_pos++] = c;
-    if (raw_pos >= sizeof(raw_buffer)) {
-      raw_pos = 0;
-    }
-    
-    // FIRST CHECK: Check for data frame header (F4 F3 F2 F1)
-    if (c == DATA_FRAME_HEADER[0]) {
-      // Need to check if this is actually a data frame
-      if (available() >= 4) { // Need at least 4 more bytes to verify the header and frame type
-        // Peek at the next 4 bytes to check for frame header and type
-        bool is_data_frame = true;
-        uint8_t peek_bytes[4]; // Header + frame type
-        
-        // Read the next 4 bytes without removing them from buffer
-        for (int i = 0; i < 4; i++) {
-          if (!available()) {
-            is_data_frame = false;
-            break;
-          }
-          
-          read_byte(&peek_bytes[i]);
-          
-          // First 3 bytes should match header, 4th byte is frame type
-          if (i < 3 && peek_bytes[i] != DATA_FRAME_HEADER[i+1]) {
-            is_data_frame = false;
-            break;
-          }
-        }
-        
-        if (is_data_frame) {
-          // We have a proper data frame header! Collect the whole frame
-          // The 4th byte is the frame type (0x83 for distance data, 0x84 for engineering data)
-          uint8_t frame_type = peek_bytes[3];
-          
-          // Add more verbose logging for engineering mode
-          if (operating_mode_ == "Engineering") {
-            ESP_LOGI(TAG, "In engineering mode, received frame type: 0x%02X", frame_type);
-          }
-          
-          std::vector<uint8_t> frame_data;
-          
-          // Add first 5 bytes (4 header + frame type)
-          frame_data.push_back(c);  // First byte (already read)
-          for (int i = 0; i < 4; i++) {
-            frame_data.push_back(peek_bytes[i]);
-          }
-          
-          // Read up to 100 bytes to capture the entire frame
-          // This limit is just a safety mechanism - we'll read until we have a complete frame
-          size_t max_frame_size = 100;
-          size_t bytes_read = 0;
-          
-          while (available() && bytes_read < max_frame_size) {
-            uint8_t data_byte;
-            read_byte(&data_byte);
-            frame_data.push_back(data_byte);
-            bytes_read++;
-          }
-          
-          // Process the data frame based on frame_type with additional checks
-          if (frame_type == DATA_FRAME_TYPE_DISTANCE) {
-            // MODIFICATION: If in engineering mode, process 0x83 frames as engineering data
-            if (operating_mode_ == "Engineering") {
-              ESP_LOGI(TAG, "Processing distance frame (0x83) as engineering data in engineering mode");
-              if (process_engineering_from_distance_frame_(frame_data)) {
-                // Successfully processed as engineering data
-                ESP_LOGD(TAG, "Successfully processed 0x83 frame as engineering data");
-              } else {
-                ESP_LOGW(TAG, "Failed to process 0x83 frame as engineering data");
-              }
-            } else if (process_distance_frame_(frame_data)) {
-              // Successfully processed as normal distance frame
-            } else {
-              ESP_LOGW(TAG, "Failed to process distance data frame");
-            }
-          } else if (frame_type == DATA_FRAME_TYPE_ENGINEERING) {
-            if (process_engineering_data_(frame_data)) {
-              ESP_LOGD(TAG, "Successfully processed engineering data frame");
-            } else {
-              ESP_LOGV(TAG, "Failed to process engineering data frame");
-            }
-          } else {
-            ESP_LOGD(TAG, "Unknown frame type: 0x%02X", frame_type);
-          }
-          
-          continue; // Skip further processing for this byte
-        } else {
-          // Not a valid data frame, add all read bytes to line buffer
-          line_buffer_ += (char)c;
-          for (int i = 0; i < 4 && !is_data_frame; i++) {
-            line_buffer_ += (char)peek_bytes[i];
-          }
-        }
-      }
-    }
-    
-    // SECOND CHECK: Check for command/response frame header (FD FC FB FA)
-    else if (c == FRAME_HEADER[0]) {
-      // Only consider it a frame header if we have enough bytes available
-      // ...existing code for checking command frame...
-    }
-    
-    // Check for text data - add to line buffer
-    if (c == '\n') {
-      // Process complete line
-      if (!line_buffer_.empty()) {
-        bool should_process = millis() - last_process_time >= PROCESS_INTERVAL;
-        
-        if (should_process) {
-          last_process_time = millis();
-          
-          // Less restrictive binary check - only look for obviously non-text chars
-          bool is_binary = false;
-          for (char ch : line_buffer_) {
-            // Only consider control chars below space as binary (except tab and CR)
-            if (ch < 32 && ch != '\t' && ch != '\r' && ch != '\n') {
-              // Count actual binary characters
-              int binary_count = 0;
-              for (char c2 : line_buffer_) {
-                if (c2 < 32 && c2 != '\t' && c2 != '\r' && c2 != '\n') {
-                  binary_count++;
-                }
-              }
-              
-              // Only mark as binary if we have several binary chars (>25%)
-              if (binary_count > line_buffer_.length() / 4) {
-                is_binary = true;
-                break;
-              }
-            }
-          }
-          
-          // Debug - show the line data regardless
-          ESP_LOGI(TAG, "Received line [%d bytes]: '%s'", line_buffer_.length(), line_buffer_.c_str());
-          if (!is_binary) {
-            process_line_(line_buffer_);
-          } else {
-            ESP_LOGD(TAG, "Skipped binary data that looks like a protocol frame");
-            
-            // Debug: Show hex representation of binary data
-            char hex_buf[128] = {0};
-            for (size_t i = 0; i < std::min(line_buffer_.length(), size_t(32)); i++) {
-              sprintf(hex_buf + (i*3), "%02X ", (uint8_t)line_buffer_[i]);
-            }
-            ESP_LOGD(TAG, "Binary data hex: %s", hex_buf);
-          }
-        }
-        line_buffer_.clear();
-      }
-    } else if (c != '\r') {  // Skip \r
-      if (line_buffer_.length() < 1024) {
-        line_buffer_ += (char)c;
-        
-        // Added: Check for direct "distance:" line without proper termination
-        if (line_buffer_.length() >= 12 && 
-            line_buffer_.compare(line_buffer_.length() - 12, 9, "distance:") == 0) {
-          // We found a distance prefix - process the previous data if any
-          std::string prev_data = line_buffer_.substr(0, line_buffer_.length() - 12);
-          if (!prev_data.empty()) {
-            ESP_LOGI(TAG, "Found distance prefix, processing previous data: '%s'", prev_data.c_str());
-            process_line_(prev_data);
-          }
-          // Keep only the distance part
-          line_buffer_ = line_buffer_.substr(line_buffer_.length() - 12);
-        }
-      } else {
-        ESP_LOGW(TAG, "Line buffer overflow, clearing");
-        line_buffer_.clear();
-      }
-    }
-    
-    // Additional processing in loop to passively detect version info
-    // from normal operation output, even after initial check
-    if (!firmware_version_.empty() && firmware_version_ != "Unknown" && 
-        firmware_version_.find("HLK-LD2402") == 0 && 
-        firmware_version_.find("v") == std::string::npos) {
-      
-      // We only have model info, still looking for version number
-      if (c == '\n' && !line_buffer_.empty()) {
-        if (line_buffer_.find("v") != std::string::npos || 
-            line_buffer_.find("V") != std::string::npos ||
-            line_buffer_.find("version") != std::string::npos ||
-            line_buffer_.find("Version") != std::string::npos) {
-          
-          ESP_LOGI(TAG, "Found potential version info: %s", line_buffer_.c_str());
-          // Extract version information
-          std::string version = "HLK-LD2402";
-          
-          // Try to find version number pattern
-          for (size_t i = 0; i < line_buffer_.length(); i++) {
-            if ((i+2 < line_buffer_.length() && 
-                isdigit(line_buffer_[i]) && 
-                line_buffer_[i+1] == '.' && 
-                isdigit(line_buffer_[i+2])) ||
-                (line_buffer_[i] == 'v' || line_buffer_[i] == 'V')) {
-              
-              size_t start_pos = line_buffer_[i] == 'v' || line_buffer_[i] == 'V' ? i+1 : i;
-              size_t end_pos = line_buffer_.find_first_not_of("0123456789.", start_pos);
-              if (end_pos == std::string::npos) end_pos = line_buffer_.length();
-              
-              version = "v" + line_buffer_.substr(start_pos, end_pos - start_pos);
-              firmware_version_ = version;
-              
-              if (firmware_version_text_sensor_ != nullptr) {
-                firmware_version_text_sensor_->publish_state(version);
-                ESP_LOGI(TAG, "Updated firmware version from passive detection: %s", version.c_str());
-              }
-              break;
-            }
-          }
-        }
-      }
-    }
-  }
+  pump_uart_();
+  // Drops the target after the hold time even if the stream went quiet
+  expire_target_(millis());
   
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
+  static const uint32_t TIMEOUT_MS = 100; // Reset buffer if no data for 100ms
   // Reset buffer if no data received for a while
-  if (!line_buffer_.empty() && (millis() - last_byte_time > TIMEOUT_MS)) {
+  if (!line_buffer_.empty() && (millis() - last_byte_time_ > TIMEOUT_MS)) {
     line_buffer_.clear();
   }
+#endif
 
-  // Check calibration progress if needed
-  if (calibration_in_progress_ && calibration_progress_sensor_ != nullptr) {
-    uint32_t now = millis();
-    if (now - last_calibration_check_ >= 5000) { // Check every 5 seconds
-      last_calibration_check_ = now;
-      
-      if (send_command_(CMD_GET_CALIBRATION_STATUS)) {
-        std::vector<uint8_t> response;
-        if (read_response_(response)) {
-          // Log the complete response for debugging
-          char hex_buf[64] = {0};
-          for (size_t i = 0; i < response.size() && i < 16; i++) {
-            sprintf(hex_buf + (i*3), "%02X ", response[i]);
-          }
-          ESP_LOGD(TAG, "Calibration status response: %s", hex_buf);
-          
-          bool handled = false; // Track if we've handled the response
-          
-          // Handle the actual device response format which differs from the documentation
-          // Expected format: 06 00 0A 01 00 00 XX 00 - where XX is the progress value
-          if (!handled && response.size() >= 8) {
-            // Check for a response that matches the observed pattern
-            if (response[0] == 0x06 && response[1] == 0x00 &&
-                response[2] == 0x0A && response[3] == 0x01) {
-              
-              // Extract progress from position 6
-              uint16_t progress = response[6]; // Use only the progress byte
-              
-              ESP_LOGD(TAG, "Raw progress value: 0x%02X (%u)", progress, progress);
-              
-              // Convert to percentage - appears to be counting up to 100 (0x64)
-              uint16_t percentage = (progress * 100) / 0x64;
-              
-              // Cap to 100% 
-              if (percentage > 100) {
-                percentage = 100;
-              }
-              
-              ESP_LOGI(TAG, "Calibration progress: %u%% (raw value: %u)", 
-                      percentage, progress);
-              calibration_progress_ = percentage;
-              
-              if (this->calibration_progress_sensor_ != nullptr) {
-                this->calibration_progress_sensor_->publish_state(percentage);
-              }
-              
-              // Check if calibration is complete (progress value reaches 0x64)
-              if (progress >= 0x64) {
-                ESP_LOGI(TAG, "Calibration complete");
-                calibration_in_progress_ = false;
-                exit_config_mode_();
-              }
-              
-              // We successfully processed the response
-              handled = true;  // Mark as handled instead of using continue
-            }
-          }
-          
-          // Handle the documented response format just in case
-          if (!handled && response.size() >= 2 && response[0] == 0x00 && response[1] == 0x00) {
-            // According to protocol section 5.2.10:
-            // Response format includes 2 bytes ACK status (00 00) followed by 2 bytes percentage
-            if (response.size() >= 4) {
-              // Read percentage value - little endian (LSB first)
-              uint16_t progress = response[2] | (response[3] << 8);
-              
-              ESP_LOGD(TAG, "Raw progress value (standard format): 0x%04X (%u)", progress, progress);
-              
-              // Sanity check: ensure progress is 0-100
-              if (progress > 100) {
-                ESP_LOGW(TAG, "Invalid calibration progress value: %u, capping to 100", progress);
-                progress = 100;
-              }
-              
-              calibration_progress_ = progress;
-              ESP_LOGI(TAG, "Calibration progress: %u%% (standard format)", progress);
-              this->calibration_progress_sensor_->publish_state(progress);
-              
-              // Check if calibration is complete
-              if (progress >= 100) {
-                ESP_LOGI(TAG, "Calibration complete");
-                calibration_in_progress_ = false;
-                exit_config_mode_();
-              }
-              
-              handled = true;  // Mark as handled instead of using continue
-            }
-          }
-          
-          // If we reach here and haven't handled the response, show a warning
-          if (!handled) {
-            ESP_LOGW(TAG, "Unrecognized calibration status response format. Raw bytes:");
-            for (size_t i = 0; i < response.size() && i < 16; i++) {
-              ESP_LOGW(TAG, "  Byte[%d] = 0x%02X", i, response[i]);
-            }
-          }
-        } else {
-          ESP_LOGW(TAG, "No response to calibration status query");
-        }
-      } else {
-        ESP_LOGW(TAG, "Failed to send calibration status query");
-      }
-    }
+  // Background startup and the async commands it queued
+  run_startup_();
+  run_scheduler_();
+  process_command_queue_();
+  run_watchdog_();
+
+  // Write a deferred save once changes have been quiet for save_delay
+  if (save_pending_ && !calibration_in_progress_ && !config_mode_ && !command_queue_busy_() &&
+      millis() - save_requested_at_ >= save_delay_ms_) {
+    save_pending_ = false;
+    flush_pending_save_();
   }
+
+#ifdef USE_HLK_LD2402_CALIBRATION
+  run_calibration_();
+#endif
+  run_auto_gain_();
 }
 
 // Add new method to parse distance data frames
-bool HLKLD2402Component::process_distance_frame_(const std::vector<uint8_t> &frame_data) {
-  // Regular distance frame processing for normal mode
-  // Ensure the frame is at least the minimum expected length
-  if (frame_data.size() < 10) {
-    ESP_LOGW(TAG, "Distance frame too short: %d bytes", frame_data.size());
-    return false;
-  }
-  
-  // Additional verification: double-check that this is really a distance frame
-  // by confirming the frame type byte (should be 0x83)
-  if (frame_data.size() >= 5 && frame_data[4] != DATA_FRAME_TYPE_DISTANCE) {
-    ESP_LOGW(TAG, "Not a distance frame type: 0x%02X", frame_data[4]);
-    return false;
-  }
-  
-  // Parse the data length from the frame
-  uint16_t data_length = frame_data[6] | (frame_data[7] << 8);
-  
-  // Check if we have at least enough data for distance values
-  if (frame_data.size() < 14) {
-    ESP_LOGW(TAG, "Frame too short to contain distance data");
+// Regular distance frame processing for normal mode; type and minimum size (the fixed
+// fields of the data frame layout) are checked by the dispatcher
+bool HLKLD2402Component::process_distance_frame_(const DataFrameView &frame_data) {
+  if (!frame_data.length_matches() || frame_data.length_field() < DATA_FRAME_FIXED_BYTES)
     return false;
-  }
-  
-  // We'll use the first non-zero value as our distance
-  float min_distance_cm = 0;
-  
-  // Start at byte 13 (index 12) and look for the first valid distance
-  for (size_t i = 12; i + 3 < frame_data.size(); i += 4) {
-    uint32_t value = frame_data[i] | 
-                    (frame_data[i+1] << 8) | 
-                    (frame_data[i+2] << 16) | 
-                    (frame_data[i+3] << 24);
-                    
-    // If the value is non-zero, convert to distance
-    if (value > 0) {
-      float distance = value * 0.1f; // Convert to cm
-      
-      // If this is the first valid value, or it's closer than our current minimum
-      if (min_distance_cm == 0 || distance < min_distance_cm) {
-        min_distance_cm = distance;
-      }
-      
-      ESP_LOGV(TAG, "Distance value at pos %d: %.1f cm", i, distance);
-      
-      // Find just one valid value, then break
-      if (min_distance_cm > 0) {
-        break;
-      }
-    }
-  }
+  float min_distance_cm = frame_data.distance_cm();
+  ESP_LOGV(TAG, "Distance frame: status %u, %.0f cm", frame_data.status(), min_distance_cm);
   
   // If we found a valid distance
   if (min_distance_cm > 0) {
     // Extract the detection status from the frame data
-    uint8_t detection_status = 0;
-    if (frame_data.size() >= 9) {
-      detection_status = frame_data[8];
-    }
+    uint8_t detection_status = frame_data.status();
     
     // Log with more detailed status information
     const char* status_text = "unknown";
@@ -705,16 +806,14 @@ bool HLKLD2402Component::process_distance_frame_(const std::vector<uint8_t> &fra
       case 2: status_text = "stationary person"; break;
     }
     
-    // Always update binary sensors (no throttling needed)
-    update_binary_sensors_(min_distance_cm);
+    // Presence follows the module's own classification; unknown codes count as a target
+    TargetState observed = detection_status == 0 ? TargetState::NONE
+                           : detection_status == 2 ? TargetState::STATIONARY
+                                                   : TargetState::MOVING;
+    observe_target_(observed, min_distance_cm, millis());
     
-    // For distance sensor, check throttling
-    uint32_t now = millis();
-    bool throttled = (this->distance_sensor_ != nullptr && 
-                     now - last_distance_update_ < distance_throttle_ms_);
-    
-    // Only update distance sensor if not throttled
-    if (!throttled && this->distance_sensor_ != nullptr) {
+    // The distance sensor gets one value per throttle window
+    if (publish_distance_(min_distance_cm)) {
       static float last_reported_distance = 0;
       bool significant_change = fabsf(min_distance_cm - last_reported_distance) > 10.0f;
       
@@ -724,238 +823,231 @@ bool HLKLD2402Component::process_distance_frame_(const std::vector<uint8_t> &fra
       } else {
         ESP_LOGV(TAG, "Detected %s at distance (binary): %.1f cm", status_text, min_distance_cm);
       }
-      
-      this->distance_sensor_->publish_state(min_distance_cm);
-      last_distance_update_ = now;
       ESP_LOGD(TAG, "Updated distance sensor");
     }
     
     return true;
   }
   
+  // A frame without a distance has no target
+  observe_target_(TargetState::NONE, 0.0f, millis());
+  publish_distance_(0);
   return false;  // No valid distance found
 }
 
-// Add new method to process engineering data from 0x83 frames
-bool HLKLD2402Component::process_engineering_from_distance_frame_(const std::vector<uint8_t> &frame_data) {
-  // Early exit if engineering data processing is not enabled
-  if (!engineering_data_enabled_) {
-    ESP_LOGD(TAG, "Engineering data processing disabled");
+// Every target distance goes into the window; its statistic is published once the throttle
+// allows. No-target samples (0) only close the window, so they can't pull min or mean towards
+// 0; a window without any target publishes 0.
+bool HLKLD2402Component::publish_distance_(float distance_cm) {
+  uint32_t now = millis();
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  // The filter runs on every sample so the velocity stays valid without a distance sensor
+  distance_cm = filter_distance_(distance_cm, now);
+  if (this->distance_sensor_ == nullptr && this->distance_velocity_sensor_ == nullptr)
     return false;
-  }
-  
-  if (energy_gate_sensors_.empty()) {
-    ESP_LOGD(TAG, "No energy gate sensors configured");
+#else
+  if (this->distance_sensor_ == nullptr)
     return false;
-  }
+#endif
+  if (distance_cm > 0.0f)
+    distance_window_.add(distance_cm, distance_aggregation_);
   
-  // Ensure the frame is at least the minimum expected length
-  // Header (5) + Length (2) + Some data
-  if (frame_data.size() < 10) {
-    ESP_LOGW(TAG, "Engineering frame too short: %d bytes", frame_data.size());
+  if (now - last_distance_update_ < distance_throttle_ms_)
     return false;
+  if (this->distance_sensor_ != nullptr)
+    this->distance_sensor_->publish_state(
+        distance_window_.count > 0 ? distance_window_.result(distance_aggregation_) : 0.0f);
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  if (this->distance_velocity_sensor_ != nullptr)
+    this->distance_velocity_sensor_->publish_state(distance_tracker_.velocity);
+#endif
+  distance_window_.reset();
+  last_distance_update_ = now;
+  return true;
+}
+
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+// Median first so outliers never reach the tracker. A distance of 0 means no target,
+// which passes through unfiltered and clears both stages for the next target.
+float HLKLD2402Component::filter_distance_(float distance_cm, uint32_t now) {
+  if (distance_cm <= 0.0f) {
+    distance_median_.reset();
+    distance_tracker_.reset();
+    return 0.0f;
+  }
+  return distance_tracker_.update(distance_median_.add(distance_cm), now);
+}
+#endif
+
+#ifdef USE_HLK_LD2402_ENGINEERING
+// Decodes one bank of gates energies; the caller has checked the frame holds them all
+void HLKLD2402Component::decode_gate_energies_(const DataFrameView &frame, size_t offset, uint8_t gates,
+                                               GateEnergies &out) {
+  out.count = gates;
+  decode_le32_array(frame.data + offset, gates, out.raw);
+  for (uint8_t i = 0; i < gates; i++) {
+    out.db[i] = fast_energy_db(out.raw[i]);
   }
-  
-  // Check throttling - only log and update sensors if enough time has passed
-  uint32_t now = millis();
-  bool throttled = (now - last_engineering_update_ < engineering_throttle_ms_);
-  
-  if (!throttled) {
-    // Only log the frame when not throttled
-    char hex_buf[256] = {0};
-    for (size_t i = 0; i < std::min(frame_data.size(), size_t(50)); i++) {
-      sprintf(hex_buf + (i*3), "%02X ", frame_data[i]);
-    }
-    ESP_LOGI(TAG, "Processing 0x83 frame as engineering data: %s", hex_buf);
-  }
-  
-  // For 0x83 frames in engineering mode, the energy values start at byte 13
-  // Energy values are the same values that would be "distance" in normal mode
-  const size_t motion_energy_start = 13;  // Start offset for energy values
-  const size_t motion_gate_count = DEFAULT_GATES;    // Should use DEFAULT_GATES for consistency
-  
-  // Ensure we have enough data
-  if (frame_data.size() < motion_energy_start + 4) {
-    ESP_LOGW(TAG, "Frame too short for energy data");
+}
+
+// Validates the length field against the received size, then decodes both banks
+bool HLKLD2402Component::decode_engineering_frame_(const DataFrameView &frame, EngineeringFrame &out) {
+  uint16_t length = frame.length_field();
+  if (!frame.length_matches()) {
+    ESP_LOGV(TAG, "Engineering frame length %u doesn't match %zu received bytes", length, frame.size());
     return false;
   }
+  if (length < DATA_FRAME_FIXED_BYTES + 8)
+    return false;
+  size_t gates = (length - DATA_FRAME_FIXED_BYTES) / 8;
+  if (gates > MAX_GATES)
+    return false;
   
-  // Process each gate's energy value
-  for (uint8_t i = 0; i < motion_gate_count; i++) {
-    size_t offset = motion_energy_start + (i * 4);
-    
-    // Make sure we have enough data for this gate
-    if (offset + 3 >= frame_data.size()) {
-      ESP_LOGW(TAG, "Engineering frame truncated at gate %d", i);
-      break;
-    }
-    
-    // Extract 32-bit energy value (little-endian)
-    uint32_t raw_energy = frame_data[offset] | 
-                        (frame_data[offset+1] << 8) | 
-                        (frame_data[offset+2] << 16) | 
-                        (frame_data[offset+3] << 24);
-    
-    // Convert raw energy to dB as per manual: dB = 10 * log10(raw_value)
-    // Only calculate for non-zero values to avoid log(0)
-    float db_energy = 0;
-    if (raw_energy > 0) {
-      db_energy = 10.0f * log10f(raw_energy);
-    }
-    
-    // Calculate approximate distance for this gate
-    float gate_start_distance = i * DISTANCE_GATE_SIZE;
-    float gate_end_distance = gate_start_distance + DISTANCE_GATE_SIZE;
-    
-    // Update sensor if configured for this gate and not throttled
-    if (!throttled && i < energy_gate_sensors_.size() && energy_gate_sensors_[i] != nullptr) {
-      energy_gate_sensors_[i]->publish_state(db_energy);
-      
-      // Only log gate data when not throttled
-      ESP_LOGI(TAG, "Gate %d (%.1f-%.1f m) energy: %.1f dB (raw: %u)", 
-              i, gate_start_distance, gate_end_distance, db_energy, raw_energy);
-    }
-  }
-  
-  // Update the throttle timestamp if we weren't throttled
-  if (!throttled) {
-    last_engineering_update_ = now;
-  }
-  
+  out.status = frame.status();
+  out.distance_cm = frame.distance_cm();
+  // The micromotion bank starts after all of the motion gates, decoded or not
+  uint8_t decoded = std::min<size_t>(gates, ACTIVE_GATES);
+  decode_gate_energies_(frame, DATA_FRAME_PAYLOAD_OFFSET, decoded, out.motion);
+  decode_gate_energies_(frame, DATA_FRAME_PAYLOAD_OFFSET + gates * 4, decoded, out.micromotion);
   return true;
 }
 
-// Add new method to process engineering data
-bool HLKLD2402Component::process_engineering_data_(const std::vector<uint8_t> &frame_data) {
+// Shared by both engineering handlers: decode the frame, then publish when not throttled
+bool HLKLD2402Component::handle_engineering_frame_(const DataFrameView &frame, const char *label) {
   // Early exit if engineering data processing is not enabled
   if (!engineering_data_enabled_) {
     ESP_LOGD(TAG, "Engineering data processing disabled");
     return false;
   }
   
-  if (energy_gate_sensors_.empty()) {
-    ESP_LOGD(TAG, "No energy gate sensors configured");
+  if (!decode_engineering_frame_(frame, engineering_frame_))
     return false;
-  }
   
-  // Make sure we're in engineering mode
-  // NOTE: Changed this to be more permissive - removed strict config_mode check
-  if (operating_mode_ != "Engineering") {
-    ESP_LOGW(TAG, "Received engineering data frame but not in engineering mode! Current mode: %s", 
-            operating_mode_.c_str());
-    return false;
-  }
-
-  // Ensure the frame is at least the minimum expected length
-  // Header (5) + Length (2) + Some data
-  if (frame_data.size() < 10) {
-    ESP_LOGW(TAG, "Engineering frame too short: %d bytes", frame_data.size());
-    return false;
+  // Every frame feeds the per-gate windows of the gates that have a sensor, lowest first
+  const GateEnergies &motion = engineering_frame_.motion;
+  const GateEnergies &micro = engineering_frame_.micromotion;
+  uint32_t decoded = (uint32_t(1) << motion.count) - 1;
+  GateMask configured = (energy_gate_sensors_.configured | micromotion_energy_gate_sensors_.configured) & decoded;
+  for (GateMask pending = configured; pending != 0; pending &= pending - 1) {
+    uint8_t i = __builtin_ctz(pending);
+    motion_energy_window_[i].add(motion.db[i], energy_aggregation_);
+    micromotion_energy_window_[i].add(micro.db[i], energy_aggregation_);
   }
   
   // Check throttling - only log and update sensors if enough time has passed
   uint32_t now = millis();
-  bool throttled = (now - last_engineering_update_ < engineering_throttle_ms_);
-  
-  if (!throttled) {
-    // Only log the frame when not throttled
-    char hex_buf[128] = {0};
-    for (size_t i = 0; i < std::min(frame_data.size(), size_t(40)); i++) {
-      sprintf(hex_buf + (i*3), "%02X ", frame_data[i]);
-    }
-    ESP_LOGI(TAG, "Engineering frame received: %s", hex_buf);
-  }
-  
-  // Verify frame type is engineering data (0x84)
-  if (frame_data.size() >= 5 && frame_data[4] != DATA_FRAME_TYPE_ENGINEERING) {
-    ESP_LOGW(TAG, "Not an engineering data frame: 0x%02X", frame_data[4]);
+  if (now - last_engineering_update_ < engineering_throttle_ms_)
+    return true;
+  last_engineering_update_ = now;
+  
+  ESP_LOGD(TAG, "%s frame: status %u, distance %u cm, %u gates per bank", label, engineering_frame_.status,
+           engineering_frame_.distance_cm, engineering_frame_.motion.count);
+  
+  for (GateMask pending = configured; pending != 0; pending &= pending - 1) {
+    uint8_t i = __builtin_ctz(pending);
+    float motion_db = motion_energy_window_[i].result(energy_aggregation_);
+    float micro_db = micromotion_energy_window_[i].result(energy_aggregation_);
+    motion_energy_window_[i].reset();
+    micromotion_energy_window_[i].reset();
+    bool published = publish_gate_energy_(energy_gate_sensors_, motion_energy_published_, i, motion_db, now);
+    published |= publish_gate_energy_(micromotion_energy_gate_sensors_, micromotion_energy_published_, i,
+                                      micro_db, now);
+    if (published) {
+      ESP_LOGD(TAG, "Gate %d (%.1f-%.1f m) motion %.1f dB, micromotion %.1f dB", i, GATE_START_M[i], GATE_END_M[i],
+               motion_db, micro_db);
+    }
+  }
+  ESP_LOGV(TAG, "Energy publishes: %u sent, %u inside the deadband", energy_publishes_, energy_publishes_skipped_);
+  return true;
+}
+
+// Publishes one gate of one bank if it has a sensor and the deadband policy says so
+bool HLKLD2402Component::publish_gate_energy_(const GateSensors &sensors, GatePublishState &state, uint8_t gate,
+                                              float value, uint32_t now) {
+  if (!sensors.has(gate))
+    return false;
+  if (!state.due(gate, value, now, energy_deadband_)) {
+    energy_publishes_skipped_++;
     return false;
   }
+  sensors.slots[gate]->publish_state(value);
+  state.mark(gate, value, now);
+  energy_publishes_++;
+  return true;
+}
 
-  // Process each gate's energy value
-  const size_t motion_energy_start = 10;
-  const size_t motion_gate_count = DEFAULT_GATES; // Uses DEFAULT_GATES gates from the constant
-  
-  for (uint8_t i = 0; i < motion_gate_count; i++) {
-    size_t offset = motion_energy_start + (i * 4);
-    
-    // Make sure we have enough data for this gate
-    if (offset + 3 >= frame_data.size()) {
-      ESP_LOGW(TAG, "Engineering frame truncated at gate %d", i);
-      break;
-    }
-    
-    // Extract 32-bit energy value (little-endian)
-    uint32_t raw_energy = frame_data[offset] | 
-                        (frame_data[offset+1] << 8) | 
-                        (frame_data[offset+2] << 16) | 
-                        (frame_data[offset+3] << 24);
-    
-    // Convert raw energy to dB as per manual: dB = 10 * log10(raw_value)
-    float db_energy = 0;
-    if (raw_energy > 0) { // Avoid log10(0)
-      db_energy = 10.0f * log10f(raw_energy);
-    }
-    
-    // Calculate approximate distance for this gate
-    float gate_start_distance = i * DISTANCE_GATE_SIZE;
-    float gate_end_distance = gate_start_distance + DISTANCE_GATE_SIZE;
-    
-    // Update sensor if configured for this gate and not throttled
-    if (!throttled && i < energy_gate_sensors_.size() && energy_gate_sensors_[i] != nullptr) {
-      energy_gate_sensors_[i]->publish_state(db_energy);
-      
-      // Only log gate data when not throttled
-      ESP_LOGI(TAG, "Gate %d (%.1f-%.1f m) energy: %.1f dB (raw: %u)", 
-              i, gate_start_distance, gate_end_distance, db_energy, raw_energy);
-    }
+// In engineering mode the module reports its energies in 0x83 frames
+bool HLKLD2402Component::process_engineering_from_distance_frame_(const DataFrameView &frame_data) {
+  return handle_engineering_frame_(frame_data, "Engineering (0x83)");
+}
+#endif
+
+void HLKLD2402Component::observe_target_(TargetState observed, float distance_cm, uint32_t now) {
+  if (!target_published_) {
+    target_published_ = true;
+    publish_target_state_();
   }
   
-  // Update the throttle timestamp if we weren't throttled
-  if (!throttled) {
-    last_engineering_update_ = now;
+  // Range gate with hysteresis, so a target at the boundary doesn't flap
+  if (observed != TargetState::NONE && presence_policy_.range_cm > 0.0f) {
+    float limit = presence_policy_.range_cm;
+    if (target_state_ != TargetState::NONE)
+      limit += presence_policy_.hysteresis_cm;
+    if (distance_cm > limit)
+      observed = TargetState::NONE;
   }
   
-  return true;
-}
-
-// Create a separate method for updating binary sensors to avoid code duplication
-void HLKLD2402Component::update_binary_sensors_(float distance_cm) {
-  // Update presence states based on documented ranges
-  if (this->presence_binary_sensor_ != nullptr) {
-    bool is_presence = distance_cm <= (STATIC_RANGE * 100);
-    this->presence_binary_sensor_->publish_state(is_presence);
+  if (observed == TargetState::NONE) {
+    target_candidate_ = TargetState::NONE;
+    target_candidate_frames_ = 0;
+    expire_target_(now);
+    return;
   }
   
-  if (this->micromovement_binary_sensor_ != nullptr) {
-    bool is_micro = distance_cm <= (MICROMOVEMENT_RANGE * 100);
-    this->micromovement_binary_sensor_->publish_state(is_micro);
+  target_seen_at_ = now;
+  if (observed != target_candidate_) {
+    target_candidate_ = observed;
+    target_candidate_frames_ = 0;
   }
+  if (target_candidate_frames_ < UINT8_MAX)
+    target_candidate_frames_++;
+  if (observed != target_state_ && target_candidate_frames_ >= presence_policy_.enter_frames)
+    set_target_state_(observed);
+}
+
+void HLKLD2402Component::expire_target_(uint32_t now) {
+  if (target_state_ != TargetState::NONE && now - target_seen_at_ >= presence_policy_.hold_ms)
+    set_target_state_(TargetState::NONE);
 }
 
+void HLKLD2402Component::set_target_state_(TargetState state) {
+  ESP_LOGD(TAG, "Target: %s -> %s", target_state_to_string(target_state_), target_state_to_string(state));
+  target_state_ = state;
+  target_published_ = true;
+  publish_target_state_();
+  target_state_callback_.call(state);
+}
+
+void HLKLD2402Component::publish_target_state_() {
+  if (this->presence_binary_sensor_ != nullptr)
+    this->presence_binary_sensor_->publish_state(target_state_ != TargetState::NONE);
+  if (this->micromovement_binary_sensor_ != nullptr)
+    this->micromovement_binary_sensor_->publish_state(target_state_ == TargetState::STATIONARY);
+}
+
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
 // Replace the damaged process_line_ method
 void HLKLD2402Component::process_line_(const std::string &line) {
-  ESP_LOGD(TAG, "Processing line: '%s'", line.c_str());
+  ESP_LOGV(TAG, "Processing line: '%s'", line.c_str());
   
   // Handle OFF status
   if (line == "OFF") {
-    ESP_LOGI(TAG, "No target detected");
-    if (this->presence_binary_sensor_ != nullptr) {
-      this->presence_binary_sensor_->publish_state(false);
-    }
-    if (this->micromovement_binary_sensor_ != nullptr) {
-      this->micromovement_binary_sensor_->publish_state(false);
-    }
+    ESP_LOGV(TAG, "No target detected");
+    measurement_seen_ = true;
+    observe_target_(TargetState::NONE, 0.0f, millis());
     
-    // Only update the distance sensor if not throttled
-    uint32_t now = millis();
-    bool throttled = (this->distance_sensor_ != nullptr && 
-                     now - last_distance_update_ < distance_throttle_ms_);
-    
-    if (!throttled && this->distance_sensor_ != nullptr) {
-      this->distance_sensor_->publish_state(0);
-      last_distance_update_ = now; // Update timestamp for throttling
-    }
+    // Same as a binary frame without a distance
+    publish_distance_(0);
     return;
   }
 
@@ -1007,281 +1099,778 @@ void HLKLD2402Component::process_line_(const std::string &line) {
   }
   
   if (valid_distance) {
-    // Always update binary sensors
-    update_binary_sensors_(distance_cm);
+    // Text lines don't classify the target; as before the state machine, a target within
+    // micromovement range counts as stationary (micromovement) and one beyond it as moving
+    measurement_seen_ = true;
+    observe_target_(distance_cm <= MICROMOVEMENT_RANGE * 100 ? TargetState::STATIONARY : TargetState::MOVING,
+                    distance_cm, millis());
+    
+    // The distance sensor gets one value per throttle window
+    if (publish_distance_(distance_cm)) {
+      // Use verbose level for regular updates, INFO only for significant changes
+      static float last_reported_distance = 0;
+      bool significant_change = fabsf(distance_cm - last_reported_distance) > 10.0f;
+      
+      if (significant_change) {
+        ESP_LOGI(TAG, "Detected distance (text): %.1f cm", distance_cm);
+        last_reported_distance = distance_cm;
+      } else {
+        ESP_LOGV(TAG, "Detected distance (text): %.1f cm", distance_cm);
+      }
+    }
+  }
+}
+#endif
+
+void HLKLD2402Component::dump_config() {
+  ESP_LOGCONFIG(TAG, "HLK-LD2402:");
+  ESP_LOGCONFIG(TAG, "  Firmware Version: %s", firmware_version_.c_str());
+  ESP_LOGCONFIG(TAG, "  Max Distance: %.1f m", max_distance_);
+  ESP_LOGCONFIG(TAG, "  Timeout: %u s", timeout_);
+  ESP_LOGCONFIG(TAG, "  Active Gates: %u (%.1f m)", ACTIVE_GATES, GATE_END_M[ACTIVE_GATES - 1]);
+  if (desired_mask_ != 0) {
+    uint8_t declared = 0;
+    for (uint8_t slot = 0; slot < PARAM_SLOT_COUNT; slot++) {
+      if (desired_mask_ & (1ULL << slot))
+        declared++;
+    }
+    ESP_LOGCONFIG(TAG, "  Declared Parameters: %u (reconciled at startup)", declared);
+  }
+  ESP_LOGCONFIG(TAG, "  Save Delay: %u ms", save_delay_ms_);
+  ESP_LOGCONFIG(TAG, "  Stall Timeout: %u ms", stall_timeout_ms_);
+  if (distance_sensor_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Distance Throttle: %u ms (%s per window)", distance_throttle_ms_,
+                  aggregation_to_string(distance_aggregation_));
+  }
+  ESP_LOGCONFIG(TAG, "  Presence: %u frames to enter, %u ms hold", presence_policy_.enter_frames,
+                presence_policy_.hold_ms);
+  if (presence_policy_.range_cm > 0.0f) {
+    ESP_LOGCONFIG(TAG, "  Presence Range: %.0f cm (+%.0f cm hysteresis)", presence_policy_.range_cm,
+                  presence_policy_.hysteresis_cm);
+  }
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  ESP_LOGCONFIG(TAG, "  Distance Filter: median of %u, alpha %.2f, beta %.2f", distance_median_.size,
+                distance_tracker_.alpha, distance_tracker_.beta);
+#endif
+#ifdef USE_HLK_LD2402_ENGINEERING
+  ESP_LOGCONFIG(TAG, "  Engineering Throttle: %u ms (%s per window)", engineering_throttle_ms_,
+                aggregation_to_string(energy_aggregation_));
+  ESP_LOGCONFIG(TAG, "  Energy Deadband: %.1f dB / %.0f%%, heartbeat %u s", energy_deadband_.absolute,
+                energy_deadband_.relative * 100.0f, energy_deadband_.heartbeat_ms / 1000);
+#endif
+  for (uint8_t i = 0; i < maintenance_task_count_; i++) {
+    const MaintenanceTask &task = maintenance_tasks_[i];
+    if (task.interval_ms > 0) {
+      ESP_LOGCONFIG(TAG, "  Maintenance '%s': every %u s", task.name, task.interval_ms / 1000);
+    } else {
+      ESP_LOGCONFIG(TAG, "  Maintenance '%s': once after boot", task.name);
+    }
+  }
+}
+
+// Constant frames for every command that carries no value
+const uint8_t *HLKLD2402Component::fixed_frame_(uint16_t command) {
+  switch (command) {
+    case CMD_GET_VERSION: return CommandFrame<CMD_GET_VERSION>::value.data();
+    case CMD_ENABLE_CONFIG: return CommandFrame<CMD_ENABLE_CONFIG>::value.data();
+    case CMD_DISABLE_CONFIG: return CommandFrame<CMD_DISABLE_CONFIG>::value.data();
+    case CMD_GET_SN_HEX: return CommandFrame<CMD_GET_SN_HEX>::value.data();
+    case CMD_GET_SN_CHAR: return CommandFrame<CMD_GET_SN_CHAR>::value.data();
+    case CMD_GET_CALIBRATION_STATUS: return CommandFrame<CMD_GET_CALIBRATION_STATUS>::value.data();
+    case CMD_SAVE_PARAMS: return CommandFrame<CMD_SAVE_PARAMS>::value.data();
+    case CMD_AUTO_GAIN: return CommandFrame<CMD_AUTO_GAIN>::value.data();
+    default: return nullptr;
+  }
+}
+
+bool HLKLD2402Component::send_command_(uint16_t command, const uint8_t *data, size_t len) {
+  if (len > MAX_COMMAND_PAYLOAD) {
+    ESP_LOGE(TAG, "Payload of %zu bytes too large for command 0x%04X", len, command);
+    return false;
+  }
+  
+  uint8_t buffer[MAX_FRAME_SIZE];
+  const uint8_t *frame = len == 0 ? fixed_frame_(command) : nullptr;
+  size_t size = FRAME_OVERHEAD;
+  if (frame == nullptr) {
+    size = encode_frame(command, data, len, buffer);
+    frame = buffer;
+  }
+  
+  // Log the frame we're sending for debugging
+  char hex_buf[128] = {0};
+  for (size_t i = 0; i < size && i < 40; i++) {
+    sprintf(hex_buf + (i*3), "%02X ", frame[i]);
+  }
+  ESP_LOGI(TAG, "Sending command 0x%04X, frame: %s", command, hex_buf);
+  
+  last_sent_command_ = command;
+  command_sent_at_ = millis();
+  write_array(frame, size);
+  return true;
+}
+
+void HLKLD2402Component::queue_command_(uint16_t opcode, const uint32_t *args, size_t arg_count,
+                                        CommandCallback callback) {
+  const CommandDescriptor *desc = find_command(opcode);
+  QueuedCommand queued;
+  size_t len = 0;
+  if (desc == nullptr || !encode_payload_(*desc, args, arg_count, queued.data, len)) {
+    ESP_LOGE(TAG, "Cannot queue command 0x%04X", opcode);
+    CommandResult result;
+    result.error = CommandError::INVALID;
+    callback(result, {});
+    return;
+  }
+  
+  queued.desc = desc;
+  queued.len = len;
+  queued.arg_count = arg_count;
+  queued.attempt = 0;
+  queued.started_at = 0;
+  queued.not_before = 0;
+  queued.callback = std::move(callback);
+  command_queue_.push_back(std::move(queued));
+}
+
+// Sends the next queued command once the previous one is answered or timed out
+void HLKLD2402Component::process_command_queue_() {
+  if (command_in_flight_) {
+    const CommandDescriptor *desc = command_queue_.front().desc;
+    if (millis() - command_sent_at_ < command_timeout_ms_)
+      return;
+    
+    handle_response_timeout_(*desc, command_timeout_ms_);
+    CommandResult result;
+    result.error = CommandError::TIMEOUT;
+    result.elapsed_ms = millis() - command_queue_.front().started_at;
+    record_outcome_(*desc, result);
+    complete_queued_(result, {});
+    return;
+  }
+  
+  if (command_queue_.empty())
+    return;
+  
+  QueuedCommand &next = command_queue_.front();
+  if (static_cast<int32_t>(millis() - next.not_before) < 0)
+    return;  // Backing off before a retry
+  
+  CommandResult rejected;
+  if (breaker_state_() == BreakerState::OPEN) {
+    rejected.error = CommandError::UNAVAILABLE;
+  } else if (next.desc->needs_config && !config_mode_) {
+    // Checked at send time: an earlier queued command may be the one entering config mode
+    ESP_LOGW(TAG, "'%s' needs config mode, not sending", next.desc->name);
+    rejected.error = CommandError::NOT_IN_CONFIG;
+  }
+  if (!rejected.ok()) {
+    record_outcome_(*next.desc, rejected);
+    complete_queued_(rejected, {});
+    return;
+  }
+  
+  if (!breaker_admit_())
+    return;  // Held until the probe's result is known
+  
+  if (next.attempt++ == 0) {
+    next.started_at = millis();
+  }
+  last_sent_units_ = latency_units(*next.desc, next.arg_count);
+  command_timeout_ms_ = response_timeout_(*next.desc, last_sent_units_);
+  send_command_(next.desc->opcode, next.len > 0 ? next.data : nullptr, next.len);
+  command_in_flight_ = true;
+}
+
+// Finishes the front of the queue: either schedules a retry or hands the result to the caller
+void HLKLD2402Component::complete_queued_(const CommandResult &result, const std::vector<uint8_t> &payload) {
+  command_in_flight_ = false;
+  QueuedCommand &front = command_queue_.front();
+  if (!result.ok() && retryable_(*front.desc, result)) {
+    uint32_t delay_ms = retry_delay_(retry_policy_, front.attempt);
+    if (retry_allowed_(retry_policy_, front.attempt, front.started_at, delay_ms)) {
+      ESP_LOGD(TAG, "Retrying '%s' in %u ms (%s)", front.desc->name, delay_ms, result.describe());
+      front.not_before = millis() + delay_ms;
+      return;
+    }
+  }
+  
+  QueuedCommand completed = std::move(front);
+  command_queue_.pop_front();
+  completed.callback(result, payload);
+}
+
+bool HLKLD2402Component::encode_payload_(const CommandDescriptor &desc, const uint32_t *args, size_t arg_count,
+                                         uint8_t *out, size_t &len) {
+  len = 0;
+  if (arg_count > desc.max_args) {
+    ESP_LOGE(TAG, "'%s' takes at most %u arguments, got %zu", desc.name, desc.max_args, arg_count);
+    return false;
+  }
+  
+  auto put16 = [&](uint32_t value) {
+    out[len++] = value & 0xFF;
+    out[len++] = (value >> 8) & 0xFF;
+  };
+  auto put32 = [&](uint32_t value) {
+    put16(value & 0xFFFF);
+    put16(value >> 16);
+  };
+  
+  switch (desc.payload) {
+    case PayloadLayout::NONE:
+      return true;
+    case PayloadLayout::MODE:
+      if (arg_count != 1)
+        break;
+      put16(0x0000);
+      put32(args[0]);
+      return true;
+    case PayloadLayout::PARAM_IDS:
+      if (arg_count == 0)
+        break;
+      for (size_t i = 0; i < arg_count; i++) {
+        put16(args[i]);
+      }
+      return true;
+    case PayloadLayout::PARAM_WRITE:
+      if (arg_count != 2)
+        break;
+      put16(args[0]);
+      put32(args[1]);
+      return true;
+    case PayloadLayout::COEFFICIENTS:
+      if (arg_count != 3)
+        break;
+      for (size_t i = 0; i < arg_count; i++) {
+        put16(args[i]);
+      }
+      return true;
+  }
+  
+  ESP_LOGE(TAG, "Wrong number of arguments (%zu) for '%s'", arg_count, desc.name);
+  return false;
+}
+
+// frame is what the demultiplexer routed: length (2) + echoed command (2) + status (2) + data
+CommandResult HLKLD2402Component::decode_ack_(const CommandDescriptor &desc, size_t arg_count,
+                                              const std::vector<uint8_t> &frame, std::vector<uint8_t> &payload) {
+  CommandResult result;
+  size_t offset = 4;
+  if (desc.ack != AckLayout::NOTIFICATION) {
+    if (frame.size() < 6) {
+      ESP_LOGW(TAG, "'%s' ACK too short: %zu bytes", desc.name, frame.size());
+      result.error = CommandError::MALFORMED;
+      return result;
+    }
+    result.status = frame[4] | (frame[5] << 8);
+    if (result.status != 0) {
+      ESP_LOGW(TAG, "'%s' rejected with status 0x%04X", desc.name, result.status);
+      result.error = CommandError::NAK;
+      return result;
+    }
+    offset = 6;
+  }
+  size_t available = frame.size() - std::min(frame.size(), offset);
+  
+  size_t needed = 0;
+  switch (desc.ack) {
+    case AckLayout::STATUS:
+    case AckLayout::NOTIFICATION:
+      break;
+    case AckLayout::FIXED:
+      needed = desc.ack_size;
+      break;
+    case AckLayout::PER_ARG:
+      needed = desc.ack_size * arg_count;
+      break;
+    case AckLayout::LENGTH_PREFIXED:
+      if (available < 2) {
+        needed = 2;
+        break;
+      }
+      needed = frame[offset] | (frame[offset + 1] << 8);
+      offset += 2;
+      available -= 2;
+      break;
+  }
+  
+  if (available < needed) {
+    ESP_LOGW(TAG, "'%s' ACK carries %zu bytes, expected %zu", desc.name, available, needed);
+    result.error = CommandError::MALFORMED;
+    return result;
+  }
+  payload.assign(frame.begin() + offset, frame.begin() + offset + (desc.ack == AckLayout::LENGTH_PREFIXED ? needed : available));
+  return result;
+}
+
+CommandResult HLKLD2402Component::execute_command_(uint16_t opcode, const uint32_t *args, size_t arg_count,
+                                                   std::vector<uint8_t> *payload) {
+  CommandResult result;
+  const CommandDescriptor *desc = find_command(opcode);
+  uint8_t data[MAX_COMMAND_PAYLOAD];
+  size_t len = 0;
+  if (desc == nullptr || !encode_payload_(*desc, args, arg_count, data, len)) {
+    ESP_LOGE(TAG, "Invalid request for command 0x%04X", opcode);
+    result.error = CommandError::INVALID;
+    return result;
+  }
+  
+  uint32_t started_at = millis();
+  for (uint8_t attempt = 1;; attempt++) {
+    result = transact_(*desc, data, len, arg_count, payload);
+    result.elapsed_ms = millis() - started_at;
+    record_outcome_(*desc, result);
+    if (result.ok() || !retryable_(*desc, result))
+      return result;
+    
+    uint32_t delay_ms = retry_delay_(retry_policy_, attempt);
+    if (!retry_allowed_(retry_policy_, attempt, started_at, delay_ms))
+      return result;
+    ESP_LOGD(TAG, "Retrying '%s' in %u ms (%s)", desc->name, delay_ms, result.describe());
+    pump_for_(delay_ms);
+  }
+}
+
+// One send/wait/decode round trip, no retries
+CommandResult HLKLD2402Component::transact_(const CommandDescriptor &desc, const uint8_t *data, size_t len,
+                                            size_t arg_count, std::vector<uint8_t> *payload) {
+  CommandResult result;
+  if (breaker_open_()) {
+    result.error = CommandError::UNAVAILABLE;
+    return result;
+  }
+  if (desc.needs_config && !config_mode_) {
+    ESP_LOGE(TAG, "'%s' needs config mode", desc.name);
+    result.error = CommandError::NOT_IN_CONFIG;
+    return result;
+  }
+  if (!breaker_admit_()) {
+    result.error = CommandError::UNAVAILABLE;
+    return result;
+  }
+  
+  last_sent_units_ = latency_units(desc, arg_count);
+  send_command_(desc.opcode, len > 0 ? data : nullptr, len);
+  uint32_t timeout_ms = response_timeout_(desc, last_sent_units_);
+  std::vector<uint8_t> frame;
+  if (!wait_for_frame_(desc.opcode, frame, timeout_ms)) {
+    handle_response_timeout_(desc, timeout_ms);
+    result.error = CommandError::TIMEOUT;
+    return result;
+  }
+  
+  std::vector<uint8_t> decoded;
+  result = decode_ack_(desc, arg_count, frame, decoded);
+  if (result.ok() && payload != nullptr) {
+    *payload = std::move(decoded);
+  }
+  return result;
+}
+
+bool HLKLD2402Component::retryable_(const CommandDescriptor &desc, const CommandResult &result) {
+  if (desc.ack_optional)
+    return false;
+  return result.error == CommandError::TIMEOUT || result.error == CommandError::MALFORMED;
+}
+
+// Exponential backoff: base, 2x base, 4x base ... plus jitter
+uint32_t HLKLD2402Component::retry_delay_(const RetryPolicy &policy, uint8_t failed_attempts) const {
+  uint8_t shift = std::min<uint8_t>(failed_attempts > 0 ? failed_attempts - 1 : 0, 8);
+  uint32_t jitter = policy.jitter_ms > 0 ? random_uint32() % policy.jitter_ms : 0;
+  return (policy.base_delay_ms << shift) + jitter;
+}
+
+bool HLKLD2402Component::retry_allowed_(const RetryPolicy &policy, uint8_t failed_attempts, uint32_t started_at,
+                                        uint32_t delay_ms) const {
+  if (failed_attempts >= policy.attempts || breaker_open_())
+    return false;
+  return millis() - started_at + delay_ms < policy.deadline_ms;
+}
+
+BreakerState HLKLD2402Component::breaker_state_() const {
+  if (consecutive_timeouts_ < breaker_threshold_)
+    return BreakerState::CLOSED;
+  return millis() - breaker_opened_at_ < breaker_cooldown_ms_ ? BreakerState::OPEN : BreakerState::HALF_OPEN;
+}
+
+bool HLKLD2402Component::breaker_open_() const {
+  BreakerState state = breaker_state_();
+  return state == BreakerState::OPEN || (state == BreakerState::HALF_OPEN && breaker_probe_in_flight_);
+}
+
+// Marks the command about to be sent as the probe when the breaker is half-open
+bool HLKLD2402Component::breaker_admit_() {
+  BreakerState state = breaker_state_();
+  if (state == BreakerState::CLOSED)
+    return true;
+  if (state == BreakerState::OPEN || breaker_probe_in_flight_)
+    return false;
+  breaker_probe_in_flight_ = true;
+  ESP_LOGD(TAG, "Probing the radar");
+  return true;
+}
+
+// Consecutive timeouts open the breaker; any ACK at all closes it again. A probe's
+// timeout reopens it for another cooldown. Commands that were never sent don't count.
+void HLKLD2402Component::update_breaker_(const CommandDescriptor &desc, const CommandResult &result) {
+  if (result.error != CommandError::NONE && result.error != CommandError::TIMEOUT &&
+      result.error != CommandError::NAK && result.error != CommandError::MALFORMED)
+    return;
+  breaker_probe_in_flight_ = false;
+  if (result.error == CommandError::TIMEOUT) {
+    // A missing optional ACK proves nothing either way; when half-open the next command probes again
+    if (desc.ack_optional)
+      return;
+    if (consecutive_timeouts_ < UINT8_MAX)
+      consecutive_timeouts_++;
+    if (consecutive_timeouts_ >= breaker_threshold_) {
+      breaker_opened_at_ = millis();
+      ESP_LOGW(TAG, "Radar unresponsive after %u timeouts, pausing commands for %u s", consecutive_timeouts_,
+               breaker_cooldown_ms_ / 1000);
+    }
+    return;
+  }
+  if (consecutive_timeouts_ >= breaker_threshold_) {
+    ESP_LOGI(TAG, "Radar is responding again");
+  }
+  consecutive_timeouts_ = 0;
+}
+
+void HLKLD2402Component::pump_for_(uint32_t duration_ms) {
+  uint32_t start = millis();
+  while (millis() - start < duration_ms) {
+    pump_uart_();
+    yield();
+  }
+}
+
+void HLKLD2402Component::record_latency_(const CommandDescriptor &desc, uint32_t latency_ms, uint8_t units) {
+  CommandStats &stats = command_stats_[&desc - COMMAND_TABLE];
+  // Stored per unit, rounded up so short per-parameter latencies don't become 0
+  stats.samples[stats.next] = std::min((latency_ms + units - 1) / units, uint32_t(UINT16_MAX));
+  stats.next = (stats.next + 1) % LATENCY_SAMPLES;
+  if (stats.count < LATENCY_SAMPLES)
+    stats.count++;
+  ESP_LOGV(TAG, "'%s' answered in %u ms (%u units)", desc.name, latency_ms, units);
+}
+
+void HLKLD2402Component::record_outcome_(const CommandDescriptor &desc, const CommandResult &result) {
+  update_breaker_(desc, result);
+  // A missing optional ACK is expected behaviour, not a link problem
+  if (result.error == CommandError::TIMEOUT && desc.ack_optional)
+    return;
+  command_stats_[&desc - COMMAND_TABLE].outcomes[static_cast<uint8_t>(result.error)]++;
+  command_stats_changed_ = true;
+  if (!result.ok()) {
+    ESP_LOGD(TAG, "'%s' failed: %s after %u ms", desc.name, result.describe(), result.elapsed_ms);
+  }
+}
+
+uint32_t HLKLD2402Component::latency_percentile_(const CommandDescriptor &desc, uint8_t percentile) const {
+  const CommandStats &stats = command_stats_[&desc - COMMAND_TABLE];
+  if (stats.count == 0)
+    return 0;
+  uint16_t sorted[LATENCY_SAMPLES];
+  std::copy(stats.samples, stats.samples + stats.count, sorted);
+  std::sort(sorted, sorted + stats.count);
+  // Nearest-rank percentile
+  size_t rank = (stats.count * percentile + 99) / 100;
+  return sorted[std::max(rank, size_t(1)) - 1];
+}
+
+uint32_t HLKLD2402Component::response_timeout_(const CommandDescriptor &desc, uint8_t units) const {
+  if (command_stats_[&desc - COMMAND_TABLE].count < LATENCY_MIN_SAMPLES)
+    return desc.timeout_ms;
+  uint32_t adaptive =
+      std::max(latency_percentile_(desc, 99) * units * LATENCY_TIMEOUT_FACTOR, LATENCY_TIMEOUT_FLOOR_MS);
+  return std::min(adaptive, uint32_t(desc.timeout_ms));
+}
+
+void HLKLD2402Component::handle_response_timeout_(const CommandDescriptor &desc, uint32_t timeout_ms) {
+  if (!desc.ack_optional) {
+    ESP_LOGW(TAG, "No response to '%s' after %u ms", desc.name, timeout_ms);
+  }
+  if (timeout_ms < desc.timeout_ms) {
+    // The module got slower than what we learned; fall back to the table timeout and relearn
+    ESP_LOGD(TAG, "Resetting latency history for '%s'", desc.name);
+    command_stats_[&desc - COMMAND_TABLE].count = 0;
+    command_stats_[&desc - COMMAND_TABLE].next = 0;
+  }
+}
+
+// Publishes failure counts and latency percentiles; called when a config session ends
+void HLKLD2402Component::publish_command_stats_() {
+  if (!command_stats_changed_)
+    return;
+  command_stats_changed_ = false;
+  
+  uint32_t total = 0;
+  uint32_t failed = 0;
+  std::string summary;
+  char entry[48];
+  for (size_t i = 0; i < COMMAND_COUNT; i++) {
+    const CommandStats &stats = command_stats_[i];
+    uint32_t command_total = 0;
+    for (uint8_t e = 0; e < COMMAND_ERROR_COUNT; e++) {
+      command_total += stats.outcomes[e];
+    }
+    uint32_t command_failed = command_total - stats.outcomes[static_cast<uint8_t>(CommandError::NONE)];
+    total += command_total;
+    failed += command_failed;
+    if (command_failed > 0) {
+      ESP_LOGD(TAG, "'%s': %u ok, %u timeout, %u NAK, %u malformed, %u other", COMMAND_TABLE[i].name,
+               stats.outcomes[static_cast<uint8_t>(CommandError::NONE)],
+               stats.outcomes[static_cast<uint8_t>(CommandError::TIMEOUT)],
+               stats.outcomes[static_cast<uint8_t>(CommandError::NAK)],
+               stats.outcomes[static_cast<uint8_t>(CommandError::MALFORMED)],
+               command_failed - stats.outcomes[static_cast<uint8_t>(CommandError::TIMEOUT)] -
+                   stats.outcomes[static_cast<uint8_t>(CommandError::NAK)] -
+                   stats.outcomes[static_cast<uint8_t>(CommandError::MALFORMED)]);
+    }
+    
+    if (stats.count == 0)
+      continue;
+    // "name p50/p99" for every command with latency samples
+    snprintf(entry, sizeof(entry), "%s%s %u/%u ms", summary.empty() ? "" : ", ", COMMAND_TABLE[i].name,
+             latency_percentile_(COMMAND_TABLE[i], 50), latency_percentile_(COMMAND_TABLE[i], 99));
+    summary += entry;
+  }
+  
+  ESP_LOGD(TAG, "Command latency p50/p99: %s", summary.c_str());
+  if (command_latency_text_sensor_ != nullptr) {
+    command_latency_text_sensor_->publish_state(summary);
+  }
+  if (command_errors_sensor_ != nullptr) {
+    command_errors_sensor_->publish_state(failed);
+  }
+  if (command_error_rate_sensor_ != nullptr && total > 0) {
+    command_error_rate_sensor_->publish_state(100.0f * failed / total);
+  }
+}
+
+// Called for every complete data frame or text line. Command ACKs don't count: a module
+// stuck in config mode still answers commands but has stopped streaming.
+void HLKLD2402Component::note_stream_unit_() {
+  uint32_t now = millis();
+  uint32_t interval = now - last_stream_unit_at_;
+  if (last_stream_unit_at_ != 0 && interval < stall_timeout_ms_) {
+    // Smoothed with 1/8 weight so a single burst or gap doesn't move it much
+    stream_cadence_ms_ = stream_cadence_ms_ == 0 ? interval : (stream_cadence_ms_ * 7 + interval) / 8;
+  }
+  last_stream_unit_at_ = now;
+  
+  if (recovery_level_ > 0) {
+    uint8_t last_step = (recovery_level_ - 1) % RECOVERY_STEP_COUNT;
+    ESP_LOGI(TAG, "Stream recovered after %u recovery step(s), last: %s", recovery_level_,
+             RECOVERY_STEP_NAMES[last_step]);
+    recovery_level_ = 0;
+    publish_stream_health_();
+  }
+}
+
+// A dropped or truncated frame. A burst of them means we're misframing the stream.
+void HLKLD2402Component::note_desync_() {
+  uint32_t now = millis();
+  if (now - desync_window_start_ > stall_threshold_()) {
+    desync_window_start_ = now;
+    desync_events_ = 0;
+  }
+  if (++desync_events_ < DESYNC_LIMIT)
+    return;
+  
+  ESP_LOGW(TAG, "%u dropped frames within %u ms, resyncing parser", desync_events_, now - desync_window_start_);
+  desync_events_ = 0;
+  desyncs_detected_++;
+  run_recovery_step_(RecoveryStep::RESYNC_PARSER);
+}
+
+uint32_t HLKLD2402Component::stall_threshold_() const {
+  if (stream_cadence_ms_ == 0)
+    return stall_timeout_ms_;
+  uint32_t threshold = stream_cadence_ms_ * WATCHDOG_CADENCE_FACTOR;
+  return std::min(std::max(threshold, WATCHDOG_MIN_STALL_MS), stall_timeout_ms_);
+}
+
+void HLKLD2402Component::run_watchdog_() {
+  uint32_t now = millis();
+  if (startup_state_ != StartupState::DONE || calibration_in_progress_) {
+    last_stream_unit_at_ = now;
+    return;
+  }
+  
+  if (config_mode_ || command_queue_busy_()) {
+    // The module doesn't stream in config mode, so there's nothing to expect yet
+    last_stream_unit_at_ = now;
+    if (config_mode_ && !command_queue_busy_() && !maintenance_running_ && auto_gain_state_ != AutoGainState::RUNNING &&
+        now - command_sent_at_ > CONFIG_IDLE_LIMIT_MS) {
+      ESP_LOGW(TAG, "Config mode idle for %u s, leaving it", (now - command_sent_at_) / 1000);
+      recovery_counts_[static_cast<uint8_t>(RecoveryStep::EXIT_CONFIG)]++;
+      queue_exit_config_([this]() { publish_stream_health_(); });
+    }
+    return;
+  }
+  
+  uint32_t threshold = stall_threshold_();
+  if (now - last_stream_unit_at_ < threshold)
+    return;
+  
+  // Each step gets a stall period to work; later rounds of the ladder back off
+  uint8_t shift = std::min<uint8_t>(recovery_level_ / RECOVERY_STEP_COUNT, WATCHDOG_MAX_BACKOFF_SHIFT);
+  if (recovery_level_ > 0 && now - last_recovery_at_ < (threshold << shift))
+    return;
+  
+  if (recovery_level_ == 0) {
+    stalls_detected_++;
+    ESP_LOGW(TAG, "No frames or lines for %u ms (cadence %u ms), starting recovery", now - last_stream_unit_at_,
+             stream_cadence_ms_);
+  }
+  auto step = static_cast<RecoveryStep>(recovery_level_ % RECOVERY_STEP_COUNT);
+  if (recovery_level_ < UINT8_MAX)
+    recovery_level_++;
+  last_recovery_at_ = now;
+  
+  bool needs_commands = step == RecoveryStep::EXIT_CONFIG || step == RecoveryStep::REISSUE_MODE;
+  if (needs_commands && breaker_open_()) {
+    ESP_LOGD(TAG, "Skipping '%s', radar isn't answering commands", RECOVERY_STEP_NAMES[static_cast<uint8_t>(step)]);
+    return;
+  }
+  run_recovery_step_(step);
+}
+
+void HLKLD2402Component::run_recovery_step_(RecoveryStep step) {
+  ESP_LOGW(TAG, "Stream recovery: %s", RECOVERY_STEP_NAMES[static_cast<uint8_t>(step)]);
+  recovery_counts_[static_cast<uint8_t>(step)]++;
+  
+  switch (step) {
+    case RecoveryStep::RESYNC_PARSER:
+      resync_parser_();
+      break;
     
-    // For distance sensor, apply throttling
-    uint32_t now = millis();
-    bool throttled = (this->distance_sensor_ != nullptr && 
-                     now - last_distance_update_ < distance_throttle_ms_);
+    case RecoveryStep::EXIT_CONFIG:
+      // We believe config mode is closed, so don't wait for an ACK that may never come
+      send_command_(CMD_DISABLE_CONFIG);
+      break;
+    
+    case RecoveryStep::REISSUE_MODE: {
+      bool engineering = operating_mode_ == "Engineering";
+      queue_enter_config_([this, engineering](bool entered) {
+        if (!entered)
+          return;
+        queue_command_(CMD_SET_MODE, {engineering ? MODE_ENGINEERING : MODE_NORMAL},
+                       [this, engineering](const CommandResult &result, const std::vector<uint8_t> &payload) {
+          if (!result) {
+            ESP_LOGW(TAG, "Re-issuing work mode failed: %s", result.describe());
+          }
+          // Entering config mode replaced the mode text; put back what the module runs
+          operating_mode_ = engineering ? "Engineering" : "Normal";
+          publish_operating_mode_();
+          queue_exit_config_([]() {});
+        });
+      });
+      break;
+    }
     
-    if (!throttled && this->distance_sensor_ != nullptr) {
-      // Use verbose level for regular updates, INFO only for significant changes
-      static float last_reported_distance = 0;
-      bool significant_change = fabsf(distance_cm - last_reported_distance) > 10.0f;
-      
-      if (significant_change) {
-        ESP_LOGI(TAG, "Detected distance (text): %.1f cm", distance_cm);
-        last_reported_distance = distance_cm;
-      } else {
-        ESP_LOGV(TAG, "Detected distance (text): %.1f cm", distance_cm);
+    case RecoveryStep::UART_REINIT:
+      this->parent_->load_settings(false);
+      // Whatever arrived around the reinit is likely garbage
+      while (available()) {
+        uint8_t c;
+        read_byte(&c);
       }
-      
-      this->distance_sensor_->publish_state(distance_cm);
-      last_distance_update_ = now;
-    }
+      resync_parser_();
+      break;
   }
+  publish_stream_health_();
 }
 
-void HLKLD2402Component::dump_config() {
-  ESP_LOGCONFIG(TAG, "HLK-LD2402:");
-  ESP_LOGCONFIG(TAG, "  Firmware Version: %s", firmware_version_.c_str());
-  ESP_LOGCONFIG(TAG, "  Max Distance: %.1f m", max_distance_);
-  ESP_LOGCONFIG(TAG, "  Timeout: %u s", timeout_);
+void HLKLD2402Component::resync_parser_() {
+  demux_state_ = DemuxState::TEXT;
+  header_window_ = 0;
+  frame_buffer_.clear();
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
+  line_buffer_.clear();
+#endif
 }
 
-bool HLKLD2402Component::write_frame_(const std::vector<uint8_t> &frame) {
-  size_t written = 0;
-  size_t tries = 0;
-  while (written < frame.size() && tries++ < 3) {
-    size_t to_write = frame.size() - written;
-    write_array(&frame[written], to_write);  // write_array returns void
-    written += to_write;
-    if (written < frame.size()) {
-      delay(5);
-    }
+void HLKLD2402Component::publish_stream_health_() {
+  uint32_t total = 0;
+  std::string summary = recovery_level_ > 0 ? "stalled" : "ok";
+  char entry[40];
+  for (uint8_t i = 0; i < RECOVERY_STEP_COUNT; i++) {
+    total += recovery_counts_[i];
+    if (recovery_counts_[i] == 0)
+      continue;
+    snprintf(entry, sizeof(entry), ", %s %u", RECOVERY_STEP_NAMES[i], recovery_counts_[i]);
+    summary += entry;
   }
-  return written == frame.size();
-}
-
-bool HLKLD2402Component::send_command_(uint16_t command, const uint8_t *data, size_t len) {
-  std::vector<uint8_t> frame;
-  
-  // Header
-  frame.insert(frame.end(), FRAME_HEADER, FRAME_HEADER + 4);
-  
-  // Length (2 bytes) - command (2 bytes) + data length
-  uint16_t total_len = 2 + len;  // 2 for command, plus any additional data
-  frame.push_back(total_len & 0xFF);
-  frame.push_back((total_len >> 8) & 0xFF);
-  
-  // Command (2 bytes, little endian)
-  frame.push_back(command & 0xFF);
-  frame.push_back((command >> 8) & 0xFF);
-  
-  // Data (if any)
-  if (data != nullptr && len > 0) {
-    frame.insert(frame.end(), data, data + len);
+  ESP_LOGD(TAG, "Stream health: %s (%u stalls, %u desyncs)", summary.c_str(), stalls_detected_, desyncs_detected_);
+  if (stream_health_text_sensor_ != nullptr) {
+    stream_health_text_sensor_->publish_state(summary);
   }
-  
-  // Footer
-  frame.insert(frame.end(), FRAME_FOOTER, FRAME_FOOTER + 4);
-  
-  // Log the frame we're sending for debugging
-  char hex_buf[128] = {0};
-  for (size_t i = 0; i < frame.size() && i < 40; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", frame[i]);
+  if (stream_recoveries_sensor_ != nullptr) {
+    stream_recoveries_sensor_->publish_state(total);
   }
-  ESP_LOGI(TAG, "Sending command 0x%04X, frame: %s", command, hex_buf);
-  
-  return write_frame_(frame);
 }
 
-// Modify read_response_ to accept a custom timeout
-bool HLKLD2402Component::read_response_(std::vector<uint8_t> &response, uint32_t timeout_ms) {
+// Waits for a command frame with the given command word. The byte pump keeps running
+// meanwhile, so data frames and text lines are still processed.
+bool HLKLD2402Component::wait_for_frame_(uint16_t command, std::vector<uint8_t> &response, uint32_t timeout_ms) {
+  awaited_command_ = command;
+  awaiting_response_ = true;
+  response_ready_ = false;
+  
   uint32_t start = millis();
-  std::vector<uint8_t> buffer;
-  uint8_t header_match = 0;
-  uint8_t footer_match = 0;
-  
-  while ((millis() - start) < timeout_ms) {  // Use parameterized timeout
-    if (available()) {
-      uint8_t c;
-      read_byte(&c);
-      
-      // Look for header
-      if (header_match < 4) {
-        if (c == FRAME_HEADER[header_match]) {
-          header_match++;
-          buffer.push_back(c);
-        } else {
-          header_match = 0;
-          buffer.clear();
-        }
-        continue;
-      }
-      
-      buffer.push_back(c);
-      
-      // Look for footer
-      if (c == FRAME_FOOTER[footer_match]) {
-        footer_match++;
-        if (footer_match == 4) {
-          // Extract the actual response data (remove header and footer)
-          response.assign(buffer.begin() + 4, buffer.end() - 4);
-          return true;
-        }
-      } else {
-        footer_match = 0;
-      }
+  while ((millis() - start) < timeout_ms) {
+    pump_uart_();
+    if (response_ready_) {
+      awaiting_response_ = false;
+      response = std::move(awaited_response_);
+      return true;
     }
     yield();
   }
   
-  ESP_LOGW(TAG, "Response timeout after %u ms", timeout_ms);
+  awaiting_response_ = false;
   return false;
 }
 
-// Modify get_parameter_ to use a longer timeout for power interference parameter
 bool HLKLD2402Component::get_parameter_(uint16_t param_id, uint32_t &value) {
   ESP_LOGD(TAG, "Getting parameter 0x%04X", param_id);
   
-  uint8_t data[2];
-  data[0] = param_id & 0xFF;
-  data[1] = (param_id >> 8) & 0xFF;
-  
-  if (!send_command_(CMD_GET_PARAMS, data, sizeof(data))) {
-    ESP_LOGE(TAG, "Failed to send get parameter command");
-    return false;
-  }
-  
-  // Add a bigger delay for parameter 0x0005 (power interference)
-  if (param_id == PARAM_POWER_INTERFERENCE) {
-    delay(500);  // Wait longer for power interference parameter
-  } else {
-    delay(100);  // Standard delay for other parameters
-  }
-  
-  std::vector<uint8_t> response;
-  // Use longer timeout for power interference parameter
-  uint32_t timeout = (param_id == PARAM_POWER_INTERFERENCE) ? 3000 : 1000;
-  
-  if (!read_response_(response, timeout)) {
-    ESP_LOGE(TAG, "No response to get parameter command");
+  std::vector<uint8_t> payload;
+  if (!execute_command_(CMD_GET_PARAMS, {param_id}, &payload)) {
+    ESP_LOGE(TAG, "Failed to read parameter 0x%04X", param_id);
     return false;
   }
   
-  // Log the response for debugging
-  char hex_buf[64] = {0};
-  for (size_t i = 0; i < response.size() && i < 16; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
-  }
-  ESP_LOGD(TAG, "Get parameter response: %s", hex_buf);
-  
-  // Handle response in a permissive way
-  if (response.size() >= 6) {
-    // Standard response format
-    value = response[2] | (response[3] << 8) | (response[4] << 16) | (response[5] << 24);
-    ESP_LOGD(TAG, "Parameter 0x%04X value: %u", param_id, value);
-    return true;
-  } else if (response.size() >= 2) {
-    // Shorter response, but possibly valid - use first 2 bytes
-    value = response[0] | (response[1] << 8);
-    ESP_LOGW(TAG, "Short parameter response, using value: %u", value);
-    return true;
-  }
-  
-  ESP_LOGE(TAG, "Invalid parameter response format");
-  return false;
+  value = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (payload[3] << 24);
+  ESP_LOGD(TAG, "Parameter 0x%04X value: %u", param_id, value);
+  return true;
 }
 
 bool HLKLD2402Component::set_work_mode_(uint32_t mode) {
-  return set_work_mode_with_timeout_(mode, 1000);  // Use default 1000ms timeout
-}
-
-bool HLKLD2402Component::set_work_mode_with_timeout_(uint32_t mode, uint32_t timeout_ms) {
-  ESP_LOGI(TAG, "Setting work mode to %u (0x%X) with %ums timeout", mode, mode, timeout_ms);
-  
-  // Use production mode from manual instead of MODE_NORMAL
-  if (mode == MODE_NORMAL) {
-    mode = MODE_PRODUCTION;
-    ESP_LOGI(TAG, "Using production mode 0x%X", mode);
-  }
-  
-  uint8_t mode_data[6];
-  mode_data[0] = 0x00;
-  mode_data[1] = 0x00;
-  mode_data[2] = mode & 0xFF;
-  mode_data[3] = (mode >> 8) & 0xFF;
-  mode_data[4] = (mode >> 16) & 0xFF;
-  mode_data[5] = (mode >> 24) & 0xFF;
-  
-  // Log the payload data for debugging
-  ESP_LOGD(TAG, "Mode payload: %02X %02X %02X %02X %02X %02X", 
-           mode_data[0], mode_data[1], mode_data[2], 
-           mode_data[3], mode_data[4], mode_data[5]);
-  
-  if (!send_command_(CMD_SET_MODE, mode_data, sizeof(mode_data))) {
-    ESP_LOGE(TAG, "Failed to send mode command");
-    return false;
-  }
+  ESP_LOGI(TAG, "Setting work mode to %u (0x%X)", mode, mode);
   
-  // Use the extended timeout for response
-  std::vector<uint8_t> response;
-  if (!read_response_(response, timeout_ms)) {
-    ESP_LOGE(TAG, "No response to mode command (timeout: %ums)", timeout_ms);
+  if (!execute_command_(CMD_SET_MODE, {mode})) {
+    ESP_LOGE(TAG, "Failed to set work mode");
     return false;
   }
   
-  // Log the response in detail - improved hex format logging
-  ESP_LOGI(TAG, "Mode response hex bytes: %02X %02X %02X %02X %02X %02X", 
-           response.size() > 0 ? response[0] : 0, 
-           response.size() > 1 ? response[1] : 0,
-           response.size() > 2 ? response[2] : 0,
-           response.size() > 3 ? response[3] : 0,
-           response.size() > 4 ? response[4] : 0,
-           response.size() > 5 ? response[5] : 0);
-
-  // Standard success check - ACK is 0x00 0x00
-  bool success = false;
-  if (response.size() >= 2 && response[0] == 0x00 && response[1] == 0x00) {
-    success = true;
-    ESP_LOGI(TAG, "Work mode set successfully (standard ACK)");
-  }
-  // Engineering mode special case - first byte matches requested mode value
-  // Documentation shows one format but actual device uses different format
-  else if (mode == MODE_ENGINEERING && response.size() >= 3 && 
-           response[0] == (mode & 0xFF) && response[2] == (CMD_SET_MODE & 0xFF)) {
-    // The response format for engineering mode appears to be:
-    // [mode_byte] [00] [cmd_echo] [01] [00] [00]
-    success = true;
-    ESP_LOGI(TAG, "Engineering mode set successfully (device-specific response format)");
-  }
-  // NEW: Additional format for exiting engineering mode
-  else if (mode == MODE_PRODUCTION && response.size() >= 6 && 
-           response[0] == 0x04 && response[2] == (CMD_SET_MODE & 0xFF) && 
-           response[3] == 0x01 && response[4] == 0x00 && response[5] == 0x00) {
-    // When exiting engineering mode, we get: 04 00 12 01 00 00
-    // This appears to be [prev_mode] [00] [cmd_echo] [01] [00] [00]
-    success = true;
-    ESP_LOGI(TAG, "Normal mode set successfully (engineering exit response format)");
-  }
-  
-  if (success) {
-    // Update the operating mode text
-    if (mode == MODE_NORMAL || mode == MODE_PRODUCTION) {
-      operating_mode_ = "Normal";
-    } else if (mode == MODE_ENGINEERING) {
-      operating_mode_ = "Engineering";
-    } else {
-      operating_mode_ = "Unknown";
-    }
-    
-    publish_operating_mode_();
-    
-    // Clear any pending data
-    flush();
-    while (available()) {
-      uint8_t c;
-      read_byte(&c);
-    }
-    return true;
+  // Update the operating mode text
+  if (mode == MODE_NORMAL || mode == MODE_PRODUCTION) {
+    operating_mode_ = "Normal";
+  } else if (mode == MODE_ENGINEERING) {
+    operating_mode_ = "Engineering";
+  } else {
+    operating_mode_ = "Unknown";
   }
-  
-  ESP_LOGE(TAG, "Invalid response to set work mode - doesn't match expected patterns");
-  return false;
+  publish_operating_mode_();
+  return true;
 }
 
+
+#ifdef USE_HLK_LD2402_ENGINEERING
 // Keep the existing set_engineering_mode for backward compatibility (used as toggle)
 void HLKLD2402Component::set_engineering_mode() {
   // Check if we're already in Engineering mode - if so, switch back to normal
@@ -1311,7 +1900,6 @@ void HLKLD2402Component::set_engineering_mode_direct() {
   // First ensure we're not in config mode already
   if (config_mode_) {
     exit_config_mode_();
-    delay(200);
   }
   
   // Enter config mode
@@ -1321,56 +1909,9 @@ void HLKLD2402Component::set_engineering_mode_direct() {
   }
   
   // Based on the device's actual behavior seen in serial capture:
-  // 1. Clear any pending data
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
-  
-  // 2. Set engineering mode with command 0x0012, parameter 0x00000004
+  // set engineering mode with command 0x0012, parameter 0x00000004
   ESP_LOGI(TAG, "Sending engineering mode command (0x0012)...");
-  
-  // Prepare the command data: 0x0000 followed by mode 0x00000004
-  uint8_t mode_data[6];
-  mode_data[0] = 0x00;  // First two bytes are 0x0000
-  mode_data[1] = 0x00;
-  mode_data[2] = 0x04;  // Engineering mode (0x00000004), little-endian
-  mode_data[3] = 0x00;
-  mode_data[4] = 0x00;
-  mode_data[5] = 0x00;
-  
-  if (!send_command_(CMD_SET_MODE, mode_data, sizeof(mode_data))) {
-    ESP_LOGE(TAG, "Failed to send engineering mode command");
-    exit_config_mode_();
-    return;
-  }
-  
-  // 3. Wait for response with increased timeout
-  std::vector<uint8_t> response;
-  if (!read_response_(response, 2000)) {
-    ESP_LOGE(TAG, "No response to engineering mode command");
-    exit_config_mode_();
-    return;
-  }
-  
-  // 4. Validate the response
-  char hex_buf[64] = {0};
-  for (size_t i = 0; i < response.size() && i < 16; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
-  }
-  ESP_LOGI(TAG, "Engineering mode response: %s", hex_buf);
-  
-  // Check if the response indicates success
-  bool success = false;
-  if (response.size() >= 2 && response[0] == 0x00 && response[1] == 0x00) {
-    success = true;
-    ESP_LOGI(TAG, "Engineering mode set successfully (standard ACK)");
-  } else if (response.size() >= 3 && response[0] == 0x04 && response[2] == 0x12) {
-    // Special case for engineering mode response as seen in documentation
-    success = true;
-    ESP_LOGI(TAG, "Engineering mode set successfully (device-specific response format)");
-  }
+  bool success = execute_command_(CMD_SET_MODE, {MODE_ENGINEERING}).ok();
   
   if (success) {
     // Important difference from previous implementation:
@@ -1388,20 +1929,10 @@ void HLKLD2402Component::set_engineering_mode_direct() {
     // Now exit config mode as seen in the official software's behavior
     exit_config_mode_();
     
-    // Small delay
-    delay(300);
-    
-    // 5. Clear any pending data again before receiving engineering frames
-    flush();
-    while (available()) {
-      uint8_t c;
-      read_byte(&c);
-    }
-    
     // List all configured energy gate sensors
-    ESP_LOGI(TAG, "Configured energy gate sensors (%d):", energy_gate_sensors_.size());
-    for (size_t i = 0; i < energy_gate_sensors_.size(); i++) {
-      if (energy_gate_sensors_[i] != nullptr) {
+    ESP_LOGI(TAG, "Configured energy gate sensors (%u):", energy_gate_sensors_.count());
+    for (uint8_t i = 0; i < ACTIVE_GATES; i++) {
+      if (energy_gate_sensors_.has(i)) {
         ESP_LOGI(TAG, "  Gate %d: sensor configured", i);
       }
     }
@@ -1412,6 +1943,7 @@ void HLKLD2402Component::set_engineering_mode_direct() {
     exit_config_mode_();
   }
 }
+#endif
 
 // New method for directly setting normal mode without toggle logic
 void HLKLD2402Component::set_normal_mode_direct() {
@@ -1428,8 +1960,10 @@ void HLKLD2402Component::set_normal_mode_direct() {
 void HLKLD2402Component::set_normal_mode() {
   ESP_LOGI(TAG, "Switching to normal mode...");
   
+#ifdef USE_HLK_LD2402_ENGINEERING
   // IMPORTANT: Disable engineering data processing flag when returning to normal mode
   engineering_data_enabled_ = false;
+#endif
   
   // Enter config mode if not already in it
   if (!config_mode_ && !enter_config_mode_()) {
@@ -1444,12 +1978,6 @@ void HLKLD2402Component::set_normal_mode() {
     // Always exit config mode when going to normal mode
     exit_config_mode_();
     
-    // Clear any remaining data to ensure clean transition
-    flush();
-    while (available()) {
-      uint8_t c;
-      read_byte(&c);
-    }
   } else {
     ESP_LOGE(TAG, "Failed to set normal mode");
     // Still try to exit config mode
@@ -1458,547 +1986,240 @@ void HLKLD2402Component::set_normal_mode() {
 }
 
 void HLKLD2402Component::save_config() {
-  ESP_LOGI(TAG, "Saving configuration...");
-  
-  if (!enter_config_mode_()) {
-    ESP_LOGE(TAG, "Failed to enter config mode");
-    return;
-  }
-  
-  if (save_configuration_()) {
-    ESP_LOGI(TAG, "Configuration saved successfully");
-  } else {
-    ESP_LOGE(TAG, "Failed to save configuration");
-  }
-  
-  exit_config_mode_();
+  // Restart the quiet period so a burst of changes ends in a single flash write
+  save_pending_ = true;
+  save_requested_at_ = millis();
+  ESP_LOGI(TAG, "Configuration save scheduled in %u ms", save_delay_ms_);
 }
 
 bool HLKLD2402Component::save_configuration_() {
   ESP_LOGI(TAG, "Sending save configuration command...");
   
-  // Clear any pending data first to ensure a clean state
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
-  
-  // Send the save command with explicit flush
-  if (!send_command_(CMD_SAVE_PARAMS)) {
-    ESP_LOGE(TAG, "Failed to send save command");
+  CommandResult result = execute_command_(CMD_SAVE_PARAMS);
+  if (!result) {
+    ESP_LOGE(TAG, "Save configuration failed: %s", result.describe());
     return false;
   }
   
-  // IMPORTANT: Add a longer delay after sending the save command
-  // The device needs more time to process flash operations
-  delay(1000);  // Increase from 500ms to 1000ms
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response, 3000)) {  // Increase timeout to 3 seconds
-    ESP_LOGW(TAG, "No response to save command - this may indicate a firmware issue");
-    
-    // Retry with a direct send after a delay
-    delay(500);
-    if (!send_command_(CMD_SAVE_PARAMS)) {
-      ESP_LOGE(TAG, "Failed to send retry save command");
-      return false;
-    }
-    
-    // Try reading the response again after a longer delay
-    delay(1500);
-    if (!read_response_(response, 3000)) {
-      ESP_LOGE(TAG, "No response to retry save command");
-      return false;
-    }
-  }
-  
-  // Log the complete response for debugging
-  char hex_buf[128] = {0};
-  for (size_t i = 0; i < response.size() && i < 32; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
-  }
-  ESP_LOGI(TAG, "Save config response: %s", hex_buf);
-  
-  // Based on logs and protocol documentation, handle various response patterns:
-  
-  // Case 1: Standard ACK (00 00) as per documentation section 5.3
-  if (response.size() >= 2 && response[0] == 0x00 && response[1] == 0x00) {
-    ESP_LOGI(TAG, "Save configuration acknowledged with standard ACK");
-    
-    // Add a safety delay to ensure flash write completes
-    delay(500);
-    return true;
-  }
-  
-  // Case 2: Actual device response format seen in logs
-  // Format: [04 00][FD 01][00 00] - command echo pattern
-  if (response.size() >= 6 &&
-      response[0] == 0x04 && response[1] == 0x00 &&
-      response[2] == 0xFD && 
-      response[4] == 0x00 && response[5] == 0x00) {
-    
-    ESP_LOGI(TAG, "Save configuration acknowledged with device-specific format");
-    
-    // Add longer safety delay to ensure flash write completes
-    delay(1000);
-    return true;
-  }
-  
-  // Case 3: Any other non-empty response (more permissive for future firmware updates)
-  if (response.size() >= 2) {
-    ESP_LOGW(TAG, "Received non-standard save response format but continuing");
-    
-    // Log detailed bytes for diagnostics
-    ESP_LOGD(TAG, "Response details (first 6 bytes):");
-    for (size_t i = 0; i < std::min(response.size(), size_t(6)); i++) {
-      ESP_LOGD(TAG, "  Byte[%d] = 0x%02X", i, response[i]);
-    }
-    
-    // Add a very conservative delay to ensure flash operations complete
-    delay(1500);
-    return true;
-  }
-  
-  ESP_LOGW(TAG, "Unrecognized save configuration response format");
-  return false;
+  // The ACK only arrives once the flash write is done
+  ESP_LOGI(TAG, "Save configuration acknowledged");
+  return true;
 }
 
 // Update enable_auto_gain to use correct commands per documentation section 5.4
 void HLKLD2402Component::enable_auto_gain() {
-  ESP_LOGI(TAG, "Enabling auto gain...");
-  
-  if (!enter_config_mode_()) {
-    ESP_LOGE(TAG, "Failed to enter config mode");
+  if (auto_gain_state_ == AutoGainState::RUNNING) {
+    ESP_LOGW(TAG, "Auto gain already running");
     return;
   }
   
-  if (!enable_auto_gain_()) {
-    ESP_LOGE(TAG, "Failed to enable auto gain");
-    exit_config_mode_();
-    return;
-  }
-  
-  // According to section 5.4, wait for completion command response (0xF0)
-  ESP_LOGI(TAG, "Waiting for auto gain completion...");
-  uint32_t start = millis();
-  bool completion_received = false;
-  
-  // Use a 10 second timeout as auto gain may take time to complete
-  while ((millis() - start) < 10000) {
-    if (available() >= 12) { // Minimum expected frame size
-      std::vector<uint8_t> response;
-      if (read_response_(response)) {
-        // Check for the completion notification frame (CMD_AUTO_GAIN_COMPLETE = 0xF0)
-        if (response.size() >= 2 && response[0] == 0xF0 && response[1] == 0x00) {
-          ESP_LOGI(TAG, "Auto gain adjustment completed");
-          completion_received = true;
-          break;
-        }
-      }
+  ESP_LOGI(TAG, "Enabling auto gain...");
+  auto_gain_state_ = AutoGainState::RUNNING;
+  auto_gain_started_at_ = millis();
+  publish_auto_gain_state_();
+  
+  queue_enter_config_([this](bool entered) {
+    if (!entered) {
+      ESP_LOGE(TAG, "Failed to enter config mode");
+      finish_auto_gain_(AutoGainState::FAILED);
+      return;
     }
-    delay(100);
-  }
-  
-  if (!completion_received) {
-    ESP_LOGW(TAG, "Auto gain completion notification not received within timeout");
-  }
-  
-  exit_config_mode_();
-}
-
-bool HLKLD2402Component::enable_auto_gain_() {
-  // As per section 5.4, send the auto gain command
-  if (!send_command_(CMD_AUTO_GAIN)) {
-    ESP_LOGE(TAG, "Failed to send auto gain command");
-    return false;
-  }
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response)) {
-    ESP_LOGE(TAG, "No response to auto gain command");
-    return false;
-  }
-  
-  // According to the documentation, expect a standard ACK
-  if (response.size() >= 2 && response[0] == 0x00 && response[1] == 0x00) {
-    ESP_LOGI(TAG, "Auto gain command acknowledged");
-    return true;
-  }
-  
-  ESP_LOGE(TAG, "Invalid response to auto gain command");
-  return false;
+    
+    // As per section 5.4, send the auto gain command; completion (0xF0) follows on its own
+    queue_command_(CMD_AUTO_GAIN, {}, [this](const CommandResult &result, const std::vector<uint8_t> &payload) {
+      if (!result) {
+        ESP_LOGE(TAG, "Auto gain command failed: %s", result.describe());
+        finish_auto_gain_(AutoGainState::FAILED);
+        return;
+      }
+      ESP_LOGI(TAG, "Auto gain command acknowledged, waiting for completion");
+      unshadowed_changes_ = true;  // Gain is not part of the parameter shadow
+      auto_gain_started_at_ = millis();
+    });
+  });
 }
 
-// Add serial number retrieval methods
-void HLKLD2402Component::get_serial_number() {
-  ESP_LOGI(TAG, "Getting serial number...");
-  
-  if (!enter_config_mode_()) {
-    ESP_LOGE(TAG, "Failed to enter config mode");
+void HLKLD2402Component::handle_auto_gain_complete_(const std::vector<uint8_t> &frame) {
+  if (auto_gain_state_ != AutoGainState::RUNNING) {
+    ESP_LOGD(TAG, "Auto gain completion received, but no auto gain was running");
     return;
   }
-  
-  // Try HEX format first (newer firmware)
-  if (!get_serial_number_hex_()) {
-    // If that fails, try character format
-    if (!get_serial_number_char_()) {
-      ESP_LOGE(TAG, "Failed to get serial number");
-    }
-  }
-  
-  exit_config_mode_();
-}
-
-bool HLKLD2402Component::get_serial_number_hex_() {
-  if (!send_command_(CMD_GET_SN_HEX)) {
-    ESP_LOGE(TAG, "Failed to send hex SN command");
-    return false;
-  }
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response)) {
-    ESP_LOGE(TAG, "No response to hex SN command");
-    return false;
-  }
-  
-  // Per protocol section 5.2.4, response format:
-  // 2 bytes ACK + 2 bytes length + N bytes SN
-  if (response.size() >= 4 && response[0] == 0x00 && response[1] == 0x00) {
-    uint16_t sn_length = response[2] | (response[3] << 8);
-    
-    if (response.size() >= 4 + sn_length) {
-      // Format as hex string
-      std::string sn;
-      char temp[8];
-      for (size_t i = 4; i < 4 + sn_length; i++) {
-        sprintf(temp, "%02X", response[i]);
-        sn += temp;
-      }
-      
-      serial_number_ = sn;
-      ESP_LOGI(TAG, "Serial number (hex): %s", sn.c_str());
-      return true;
-    }
-  }
-  
-  return false;
+  ESP_LOGI(TAG, "Auto gain adjustment completed after %u ms", millis() - auto_gain_started_at_);
+  finish_auto_gain_(AutoGainState::COMPLETE);
 }
 
-bool HLKLD2402Component::get_serial_number_char_() {
-  if (!send_command_(CMD_GET_SN_CHAR)) {
-    ESP_LOGE(TAG, "Failed to send char SN command");
-    return false;
-  }
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response)) {
-    ESP_LOGE(TAG, "No response to char SN command");
-    return false;
-  }
-  
-  // Per protocol section 5.2.5, response format:
-  // 2 bytes ACK + 2 bytes length + N bytes SN
-  if (response.size() >= 4 && response[0] == 0x00 && response[1] == 0x00) {
-    uint16_t sn_length = response[2] | (response[3] << 8);
-    
-    if (response.size() >= 4 + sn_length) {
-      // Format as character string
-      std::string sn;
-      for (size_t i = 4; i < 4 + sn_length; i++) {
-        sn += (char)response[i];
-      }
-      
-      serial_number_ = sn;
-      ESP_LOGI(TAG, "Serial number (char): %s", sn.c_str());
-      return true;
-    }
-  }
-  
-  return false;
+void HLKLD2402Component::run_auto_gain_() {
+  if (auto_gain_state_ != AutoGainState::RUNNING || command_queue_busy_())
+    return;
+  uint32_t timeout_ms = find_command(CMD_AUTO_GAIN_COMPLETE)->timeout_ms;
+  if (millis() - auto_gain_started_at_ < timeout_ms)
+    return;
+  ESP_LOGW(TAG, "Auto gain completion notification not received within %u ms", timeout_ms);
+  finish_auto_gain_(AutoGainState::TIMED_OUT);
 }
 
-void HLKLD2402Component::check_power_interference() {
-  ESP_LOGI(TAG, "Checking power interference status");
-  
-  // Clear any pending data first
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
-  
-  // Flag to track if we entered config mode in this function
-  bool entered_config_mode = false;
-  
-  if (!config_mode_) {
-    if (!enter_config_mode_()) {
-      ESP_LOGE(TAG, "Failed to enter config mode for power interference check");
-      
-      // Show ERROR state if the check fails
-      if (this->power_interference_binary_sensor_ != nullptr) {
-        this->power_interference_binary_sensor_->publish_state(true);  // Show interference/error
-        ESP_LOGE(TAG, "Setting power interference to ON (ERROR) due to config mode failure");
-      }
-      return;
-    }
-    entered_config_mode = true;
-  }
-  
-  // According to documentation, use GET_PARAMS command (0x0008) with parameter ID 0x0005
-  ESP_LOGI(TAG, "Reading power interference parameter...");
-  uint8_t param_data[2];
-  param_data[0] = PARAM_POWER_INTERFERENCE & 0xFF;  // 0x05
-  param_data[1] = (PARAM_POWER_INTERFERENCE >> 8) & 0xFF;  // 0x00  
+// Publishes the outcome and closes the session. After a completion the thresholds are
+// re-read first, so the trigger sees sensors that match the module.
+void HLKLD2402Component::finish_auto_gain_(AutoGainState state) {
+  auto_gain_state_ = state;
+  publish_auto_gain_state_();
+  if (!config_mode_)
+    return;
   
-  if (!send_command_(CMD_GET_PARAMS, param_data, sizeof(param_data))) {
-    ESP_LOGE(TAG, "Failed to send power interference parameter query");
-    
-    if (this->power_interference_binary_sensor_ != nullptr) {
-      this->power_interference_binary_sensor_->publish_state(true);  // Show interference/error
-      ESP_LOGE(TAG, "Setting power interference to ON (ERROR) due to command failure");
-    }
-    
-    // Exit config mode if we entered it
-    if (entered_config_mode) {
-      exit_config_mode_();
-    }
+  if (state != AutoGainState::COMPLETE) {
+    queue_exit_config_([]() {});
     return;
   }
+  auto leave = [this]() {
+    queue_exit_config_([this]() { auto_gain_complete_callback_.call(); });
+  };
+#ifdef USE_HLK_LD2402_THRESHOLDS
+  queue_threshold_refresh_(std::move(leave));
+#else
+  leave();
+#endif
+}
+
+void HLKLD2402Component::publish_auto_gain_state_() {
+  if (auto_gain_text_sensor_ != nullptr) {
+    auto_gain_text_sensor_->publish_state(AUTO_GAIN_STATE_NAMES[static_cast<uint8_t>(auto_gain_state_)]);
+  }
+}
+
+// Add serial number retrieval methods
+void HLKLD2402Component::get_serial_number() {
+  ESP_LOGI(TAG, "Getting serial number...");
   
-  // Wait for response
-  delay(500);
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response, 2000)) {
-    ESP_LOGE(TAG, "No response to power interference parameter query");
-    
-    if (this->power_interference_binary_sensor_ != nullptr) {
-      this->power_interference_binary_sensor_->publish_state(true);  // Show interference/error
-      ESP_LOGE(TAG, "Setting power interference to ON (ERROR) due to timeout");
-    }
-    
-    // Exit config mode if we entered it
-    if (entered_config_mode) {
-      exit_config_mode_();
-    }
+  if (!enter_config_mode_()) {
+    ESP_LOGE(TAG, "Failed to enter config mode");
     return;
   }
   
-  // Log the response for debugging
-  char hex_buf[128] = {0};
-  for (size_t i = 0; i < response.size() && i < 30; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
-  }
-  ESP_LOGI(TAG, "Power interference response: %s", hex_buf);
-  
-  // According to documentation:
-  // The response format is:
-  // CMD (2 bytes) + ACK (2 bytes) + Parameter ID (2 bytes) + Parameter value (4 bytes)
-  bool has_interference = false;
-  
-  // Based on the protocol documentation and our response:
-  // 0: Not performed
-  // 1: No interference
-  // 2: Has interference
-  if (response.size() >= 10) {
-    // Parameter value is at offset 6-9, little endian
-    uint32_t value = response[6] | (response[7] << 8) | (response[8] << 16) | (response[9] << 24);
-    ESP_LOGI(TAG, "Power interference value: %u", value);
-    
-    if (value == 0) {
-      ESP_LOGI(TAG, "Power interference check not performed");
-      has_interference = false;
-    } else if (value == 1) {
-      ESP_LOGI(TAG, "No power interference detected");
-      has_interference = false;
-    } else if (value == 2) {
-      ESP_LOGI(TAG, "Power interference detected");
-      has_interference = true;
-    } else {
-      ESP_LOGW(TAG, "Unknown power interference value: %u", value);
-      has_interference = (value != 1);  // Consider anything other than 1 as interference
+  // Try HEX format first (newer firmware)
+  if (!get_serial_number_hex_()) {
+    // If that fails, try character format
+    if (!get_serial_number_char_()) {
+      ESP_LOGE(TAG, "Failed to get serial number");
     }
-  } else {
-    ESP_LOGW(TAG, "Invalid power interference parameter response format");
-    has_interference = true;  // Assume interference on invalid response
   }
   
-  // Update sensor state
-  if (this->power_interference_binary_sensor_ != nullptr) {
-    this->power_interference_binary_sensor_->publish_state(has_interference);
-    ESP_LOGI(TAG, "Set power interference to %s based on parameter value", 
-             has_interference ? "ON (interference detected)" : "OFF (no interference)");
+  exit_config_mode_();
+}
+
+bool HLKLD2402Component::get_serial_number_hex_() {
+  // Per protocol section 5.2.4 the ACK carries a length-prefixed SN
+  std::vector<uint8_t> payload;
+  if (!execute_command_(CMD_GET_SN_HEX, {}, &payload)) {
+    ESP_LOGE(TAG, "Hex SN command failed");
+    return false;
+  }
+  
+  // Format as hex string
+  std::string sn;
+  char temp[8];
+  for (uint8_t byte : payload) {
+    sprintf(temp, "%02X", byte);
+    sn += temp;
   }
   
-  // Exit config mode if we entered it in this function
-  if (entered_config_mode) {
-    exit_config_mode_();
+  serial_number_ = sn;
+  ESP_LOGI(TAG, "Serial number (hex): %s", sn.c_str());
+  return true;
+}
+
+bool HLKLD2402Component::get_serial_number_char_() {
+  // Per protocol section 5.2.5 the ACK carries a length-prefixed SN
+  std::vector<uint8_t> payload;
+  if (!execute_command_(CMD_GET_SN_CHAR, {}, &payload)) {
+    ESP_LOGE(TAG, "Char SN command failed");
+    return false;
   }
+  
+  serial_number_.assign(payload.begin(), payload.end());
+  ESP_LOGI(TAG, "Serial number (char): %s", serial_number_.c_str());
+  return true;
+}
+
+void HLKLD2402Component::check_power_interference() {
+  if (power_interference_task_ < 0)
+    return;
+  ESP_LOGI(TAG, "Power interference check requested");
+  maintenance_tasks_[power_interference_task_].enabled = true;
+  maintenance_tasks_[power_interference_task_].next_run = millis();
 }
 
+// Single precision; thresholds are only converted on config writes. Rounded, so a value
+// read back and converted again maps to the same raw threshold.
 uint32_t HLKLD2402Component::db_to_threshold_(float db_value) {
-  return static_cast<uint32_t>(pow(10, db_value / 10)); 
+  return static_cast<uint32_t>(exp2f(db_value * (10000.0f / DB_PER_OCTAVE_E4)) + 0.5f);
 }
 
+#ifdef USE_HLK_LD2402_THRESHOLDS
 float HLKLD2402Component::threshold_to_db_(uint32_t threshold) {
-  return 10 * log10(threshold);
+  return fast_energy_db(threshold);
 }
+#endif
 
 void HLKLD2402Component::factory_reset() {
   ESP_LOGI(TAG, "Performing factory reset...");
   
-  // Clear UART buffers before starting
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
   
   if (!enter_config_mode_()) {
     ESP_LOGE(TAG, "Failed to enter config mode for factory reset");
     return;
   }
   
-  // Add a delay after entering config mode
-  delay(200);
-  
   ESP_LOGI(TAG, "Resetting max distance to default (5m)");
   set_parameter_(PARAM_MAX_DISTANCE, 50);  // 5.0m = 50 (internal value is in decimeters)
-  delay(200);  // Add delay between parameter setting
   
   ESP_LOGI(TAG, "Resetting target timeout to default (5s)");
   set_parameter_(PARAM_TIMEOUT, 5);
-  delay(200);
   
   // Reset only trigger threshold for gate 0 as an example
   ESP_LOGI(TAG, "Resetting main threshold values");
   set_parameter_(PARAM_TRIGGER_THRESHOLD, 30);  // 30 = ~3.0 coefficient
-  delay(200);  
   
   set_parameter_(PARAM_MICRO_THRESHOLD, 30);
-  delay(200);  
-  
-  // Save configuration
-  ESP_LOGI(TAG, "Saving factory reset configuration");
-  if (send_command_(CMD_SAVE_PARAMS)) {
-    std::vector<uint8_t> response;
-    
-    // Wait a bit longer for save operation
-    delay(300);
-    
-    if (read_response_(response)) {
-      // Log the response for debugging
-      char hex_buf[64] = {0};
-      for (size_t i = 0; i < response.size() && i < 16; i++) {
-        sprintf(hex_buf + (i*3), "%02X ", response[i]);
-      }
-      ESP_LOGI(TAG, "Save config response: %s", hex_buf);
-      ESP_LOGI(TAG, "Configuration saved successfully");
-    } else {
-      ESP_LOGW(TAG, "No response to save configuration command");
-    }
-  } else {
-    ESP_LOGW(TAG, "Failed to send save command");
-  }
   
-  // Add a final delay before exiting config mode
-  delay(500);
+  // Persist through the deferred save path like any other change
+  ESP_LOGI(TAG, "Scheduling save of factory reset configuration");
+  save_config();
   
-  // Use safer exit pattern
   ESP_LOGI(TAG, "Exiting config mode");
-  send_command_(CMD_DISABLE_CONFIG);
-  delay(200);
-  config_mode_ = false;
+  exit_config_mode_();
   
   ESP_LOGI(TAG, "Factory reset completed");
 }
 
 // Make sure we have matching implementations for ALL protected methods
-bool HLKLD2402Component::enter_config_mode_() {
+// Returns the final result, so callers can see why entry failed
+CommandResult HLKLD2402Component::enter_config_mode_() {
+  CommandResult result;
   if (config_mode_)
-    return true;
+    return result;
+  
+  if (command_queue_busy_()) {
+    ESP_LOGW(TAG, "Background commands still running, try again shortly");
+    result.error = CommandError::BUSY;
+    return result;
+  }
     
   ESP_LOGD(TAG, "Entering config mode...");
   
-  // Clear any pending data first
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
+  // ACK carries protocol version (2) + buffer size (2) after the status
+  result = execute_command_(CMD_ENABLE_CONFIG);
+  if (!result) {
+    ESP_LOGE(TAG, "Failed to enter config mode: %s", result.describe());
+    return result;
   }
   
-  // Try multiple times with delays
-  for (int attempt = 0; attempt < 3; attempt++) {
-    ESP_LOGI(TAG, "Config mode attempt %d", attempt + 1);
-    
-    // Send the command with no data
-    if (!send_command_(CMD_ENABLE_CONFIG)) {
-      ESP_LOGE(TAG, "Failed to send config mode command");
-      delay(500);  // Wait before retrying
-      continue;
-    }
-    
-    // Delay slightly to ensure response has time to arrive
-    delay(200);
-    
-    // Check for response with timeout
-    uint32_t start = millis();
-    while ((millis() - start) < 1000) {  // 1 second timeout
-      if (available() >= 12) {  // Minimum expected response size with header/footer
-        std::vector<uint8_t> response;
-        if (read_response_(response)) {
-          ESP_LOGI(TAG, "Received response to config mode command");
-          
-          // Dump the response bytes for debugging
-          char hex_buf[128] = {0};
-          for (size_t i = 0; i < response.size() && i < 20; i++) {
-            sprintf(hex_buf + (i*3), "%02X ", response[i]);
-          }
-          ESP_LOGI(TAG, "Response: %s", hex_buf);
-          
-          // Looking at logs, the response is: "08 00 FF 01 00 00 02 00 20 00"
-          // Format: Length (2) + Command ID (FF 01) + Status (00 00) + Protocol version (02 00) + Buffer size (20 00)
-          if (response.size() >= 6 && 
-              response[0] == 0xFF && response[1] == 0x01 && 
-              response[2] == 0x00 && response[3] == 0x00) {
-            config_mode_ = true;
-            ESP_LOGI(TAG, "Successfully entered config mode");
-            
-            // Update operating mode
-            operating_mode_ = "Config";
-            publish_operating_mode_();
-            return true;
-          } else if (response.size() >= 6 && 
-                    response[4] == 0x00 && response[5] == 0x00) {
-            // Alternative format sometimes seen
-            config_mode_ = true;
-            ESP_LOGI(TAG, "Successfully entered config mode (alt format)");
-            
-            // Update operating mode
-            operating_mode_ = "Config";
-            publish_operating_mode_();
-            return true;
-          } else {
-            ESP_LOGW(TAG, "Invalid config mode response format - expected status 00 00");
-            
-            // Trace each byte to help diagnose the issue
-            ESP_LOGW(TAG, "Response details: %d bytes", response.size());
-            for (size_t i = 0; i < response.size() && i < 10; i++) {
-              ESP_LOGW(TAG, "  Byte[%d] = 0x%02X", i, response[i]);
-            }
-          }
-        }
-      }
-      delay(50);  // Small delay between checks
-    }
-    
-    ESP_LOGW(TAG, "No valid response to config mode command, retrying");
-    delay(500);  // Wait before retrying
-  }
+  config_mode_ = true;
+  ESP_LOGI(TAG, "Successfully entered config mode");
   
-  ESP_LOGE(TAG, "Failed to enter config mode after 3 attempts");
-  return false;
+  // Update operating mode
+  operating_mode_ = "Config";
+  publish_operating_mode_();
+  return result;
 }
 
 bool HLKLD2402Component::exit_config_mode_() {
@@ -2007,24 +2228,14 @@ bool HLKLD2402Component::exit_config_mode_() {
     
   ESP_LOGD(TAG, "Exiting config mode...");
   
-  // Send exit command
-  if (send_command_(CMD_DISABLE_CONFIG)) {
-    // Brief wait for response, but don't wait too long
-    delay(200);
-    
-    // Read any response but don't wait too long
-    std::vector<uint8_t> response;
-    bool got_response = read_response_(response, 300);
-    if (got_response) {
-      ESP_LOGI(TAG, "Got response to exit command");
-    } else {
-      // Don't treat this as an error - some firmware versions may not respond
-      ESP_LOGI(TAG, "No response to exit command - this may be normal");
-    }
+  // Some firmware versions never answer, so a missing ACK isn't an error
+  if (!execute_command_(CMD_DISABLE_CONFIG)) {
+    ESP_LOGD(TAG, "Exit config mode not acknowledged");
   }
   
   // Always mark as exited regardless of response
   config_mode_ = false;
+  publish_command_stats_();
   ESP_LOGI(TAG, "Left config mode");
   
   // Update operating mode back to either Normal or Engineering
@@ -2033,12 +2244,6 @@ bool HLKLD2402Component::exit_config_mode_() {
     publish_operating_mode_();
   }
   
-  // Clear any pending data to ensure clean state
-  flush();
-  while (available()) {
-    uint8_t c;
-    read_byte(&c);
-  }
   
   return true;
 }
@@ -2046,56 +2251,16 @@ bool HLKLD2402Component::exit_config_mode_() {
 bool HLKLD2402Component::set_parameter_(uint16_t param_id, uint32_t value) {
   ESP_LOGD(TAG, "Setting parameter 0x%04X to %u", param_id, value);
   
-  uint8_t data[6];
-  data[0] = param_id & 0xFF;
-  data[1] = (param_id >> 8) & 0xFF;
-  data[2] = value & 0xFF;
-  data[3] = (value >> 8) & 0xFF;
-  data[4] = (value >> 16) & 0xFF;
-  data[5] = (value >> 24) & 0xFF;
-  
-  if (!send_command_(CMD_SET_PARAMS, data, sizeof(data))) {
-    ESP_LOGE(TAG, "Failed to send set parameter command");
-    return false;
-  }
-    
-  // Add a small delay after sending command
-  delay(100);
-  
-  std::vector<uint8_t> response;
-  if (!read_response_(response)) {  // Use default timeout
-    ESP_LOGE(TAG, "No response to set parameter command");
-    return false;
-  }
-  
-  // Log the response for debugging
-  char hex_buf[64] = {0};
-  for (size_t i = 0; i < response.size() && i < 16; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
-  }
-  ESP_LOGD(TAG, "Set parameter response: %s", hex_buf);
-  
-  // Do basic error checking without being too strict on validation
-  if (response.size() < 2) {
-    ESP_LOGE(TAG, "Response too short");
-    return false;
-  }
-  
-  // Check for known error patterns
-  bool has_error = false;
-  if (response[0] == 0xFF && response[1] == 0xFF) {
-    has_error = true;  // This typically indicates an error
-  }
-  
-  if (has_error) {
-    ESP_LOGE(TAG, "Parameter setting failed with error response");
+  if (!execute_command_(CMD_SET_PARAMS, {param_id, value})) {
+    ESP_LOGE(TAG, "Failed to set parameter 0x%04X", param_id);
     return false;
   }
   
-  // For other responses, be permissive and assume success
+  update_shadow_(param_id, value, true);
   return true;
 }
 
+#ifdef USE_HLK_LD2402_THRESHOLDS
 // Add these methods to configure thresholds for specific gates
 bool HLKLD2402Component::set_motion_threshold(uint8_t gate, float db_value) {
   ESP_LOGI(TAG, "Setting motion threshold for gate %d to %.1f dB", gate, db_value);
@@ -2185,62 +2350,244 @@ bool HLKLD2402Component::set_micromotion_threshold(uint8_t gate, float db_value)
 
 // Add a new method for batch parameter reading
 bool HLKLD2402Component::get_parameters_batch_(const std::vector<uint16_t> &param_ids, std::vector<uint32_t> &values) {
-  ESP_LOGI(TAG, "Reading %d parameters in batch mode", param_ids.size());
-  
-  // Prepare data: length of IDs array (2 bytes) followed by param IDs
-  std::vector<uint8_t> data;
-  uint16_t count = param_ids.size();
-  data.push_back(count & 0xFF);
-  data.push_back((count >> 8) & 0xFF);
+  ESP_LOGI(TAG, "Reading %zu parameters in batch mode", param_ids.size());
   
-  for (uint16_t id : param_ids) {
-    data.push_back(id & 0xFF);
-    data.push_back((id >> 8) & 0xFF);
+  std::vector<uint32_t> args(param_ids.begin(), param_ids.end());
+  std::vector<uint8_t> payload;
+  if (!execute_command_(CMD_GET_PARAMS, args.data(), args.size(), &payload)) {
+    ESP_LOGE(TAG, "Batch parameter query failed");
+    return false;
   }
   
-  if (!send_command_(CMD_GET_PARAMS, data.data(), data.size())) {
-    ESP_LOGE(TAG, "Failed to send batch parameter query");
+  return parse_parameter_values_(payload, param_ids, values);
+}
+#endif
+
+bool HLKLD2402Component::parse_parameter_values_(const std::vector<uint8_t> &payload,
+                                                 const std::vector<uint16_t> &param_ids,
+                                                 std::vector<uint32_t> &values) {
+  // One 4-byte value per requested ID, in request order
+  if (payload.size() < param_ids.size() * 4) {
+    ESP_LOGE(TAG, "Batch parameter response too short");
     return false;
   }
   
-  // Wait for response
-  delay(200);
+  values.clear();
+  for (size_t i = 0; i < param_ids.size(); i++) {
+    size_t offset = i * 4;
+    uint32_t value = payload[offset] | (payload[offset + 1] << 8) | (payload[offset + 2] << 16) |
+                     (payload[offset + 3] << 24);
+    values.push_back(value);
+    update_shadow_(param_ids[i], value);
+    ESP_LOGI(TAG, "Parameter 0x%04X value: %u (0x%08X)", param_ids[i], value, value);
+  }
+  return true;
+}
+
+int HLKLD2402Component::param_slot_(uint16_t param_id) {
+  if (param_id == PARAM_MAX_DISTANCE)
+    return PARAM_SLOT_MAX_DISTANCE;
+  if (param_id == PARAM_TIMEOUT)
+    return PARAM_SLOT_TIMEOUT;
+  if (param_id >= PARAM_TRIGGER_THRESHOLD && param_id < PARAM_TRIGGER_THRESHOLD + THRESHOLD_GATES)
+    return PARAM_SLOT_MOTION_BASE + (param_id - PARAM_TRIGGER_THRESHOLD);
+  if (param_id >= PARAM_MICRO_THRESHOLD && param_id < PARAM_MICRO_THRESHOLD + THRESHOLD_GATES)
+    return PARAM_SLOT_MICRO_BASE + (param_id - PARAM_MICRO_THRESHOLD);
+  return -1;  // Read-only or unknown parameter, not shadowed
+}
+
+uint16_t HLKLD2402Component::slot_param_id_(uint8_t slot) {
+  if (slot == PARAM_SLOT_MAX_DISTANCE)
+    return PARAM_MAX_DISTANCE;
+  if (slot == PARAM_SLOT_TIMEOUT)
+    return PARAM_TIMEOUT;
+  if (slot < PARAM_SLOT_MICRO_BASE)
+    return PARAM_TRIGGER_THRESHOLD + (slot - PARAM_SLOT_MOTION_BASE);
+  return PARAM_MICRO_THRESHOLD + (slot - PARAM_SLOT_MICRO_BASE);
+}
+
+void HLKLD2402Component::update_shadow_(uint16_t param_id, uint32_t value, bool written) {
+  int slot = param_slot_(param_id);
+  if (slot < 0)
+    return;
+  uint64_t bit = 1ULL << slot;
+  shadow_values_[slot] = value;
+  shadow_valid_mask_ |= bit;
+  
+  if (written) {
+    written_mask_ |= bit;
+  } else if (!(written_mask_ & bit) && !(saved_valid_mask_ & bit)) {
+    // Nothing written since the last save, so a read reflects what flash holds
+    saved_values_[slot] = value;
+    saved_valid_mask_ |= bit;
+  }
+}
+
+bool HLKLD2402Component::has_unsaved_changes_() const {
+  if (unshadowed_changes_)
+    return true;
+  for (uint8_t slot = 0; slot < PARAM_SLOT_COUNT; slot++) {
+    uint64_t bit = 1ULL << slot;
+    if (!(written_mask_ & bit))
+      continue;
+    // A write we can't compare, or one that wasn't reverted, needs a save
+    if (!(shadow_valid_mask_ & bit) || !(saved_valid_mask_ & bit))
+      return true;
+    if (shadow_values_[slot] != saved_values_[slot])
+      return true;
+  }
+  return false;
+}
+
+void HLKLD2402Component::mark_saved_() {
+  for (uint8_t slot = 0; slot < PARAM_SLOT_COUNT; slot++) {
+    uint64_t bit = 1ULL << slot;
+    if (shadow_valid_mask_ & bit) {
+      saved_values_[slot] = shadow_values_[slot];
+      saved_valid_mask_ |= bit;
+    } else {
+      saved_valid_mask_ &= ~bit;
+    }
+  }
+  written_mask_ = 0;
+  unshadowed_changes_ = false;
+}
+
+bool HLKLD2402Component::save_if_changed_() {
+  save_pending_ = false;
+  if (!has_unsaved_changes_()) {
+    saves_avoided_++;
+    ESP_LOGI(TAG, "Parameters match what was last saved, skipping flash write (%u avoided)", saves_avoided_);
+    if (saves_avoided_sensor_ != nullptr) {
+      saves_avoided_sensor_->publish_state(saves_avoided_);
+    }
+    return true;
+  }
   
-  std::vector<uint8_t> response;
-  if (!read_response_(response, 2000)) {
-    ESP_LOGE(TAG, "No response to batch parameter query");
+  if (!save_configuration_())
     return false;
+  mark_saved_();
+  return true;
+}
+
+void HLKLD2402Component::flush_pending_save_() {
+  if (!has_unsaved_changes_()) {
+    save_if_changed_();  // Counts the avoided save without touching config mode
+    return;
   }
   
-  // Log the response
-  char hex_buf[128] = {0};
-  for (size_t i = 0; i < response.size() && i < 30; i++) {
-    sprintf(hex_buf + (i*3), "%02X ", response[i]);
+  ESP_LOGI(TAG, "Writing deferred configuration save...");
+  if (!enter_config_mode_()) {
+    ESP_LOGE(TAG, "Failed to enter config mode for deferred save");
+    return;
+  }
+  
+  if (save_if_changed_()) {
+    ESP_LOGI(TAG, "Configuration saved successfully");
+  } else {
+    ESP_LOGE(TAG, "Failed to save configuration");
+  }
+  
+  exit_config_mode_();
+}
+
+// Compare declared parameters with the device and write only the differences.
+// Runs on the async queue inside an open config session; saves to flash only if
+// something was written. done() is called once all of it has completed.
+void HLKLD2402Component::reconcile_parameters_(std::function<void()> &&done) {
+  if (desired_mask_ == 0) {
+    ESP_LOGD(TAG, "No declared parameters to reconcile");
+    done();
+    return;
+  }
+  
+  // Read whatever the shadow doesn't know yet, in as few batch reads as possible
+  std::vector<uint16_t> unknown_ids;
+  for (uint8_t slot = 0; slot < PARAM_SLOT_COUNT; slot++) {
+    uint64_t bit = 1ULL << slot;
+    if ((desired_mask_ & bit) && !(shadow_valid_mask_ & bit)) {
+      unknown_ids.push_back(slot_param_id_(slot));
+    }
+  }
+  
+  if (unknown_ids.empty()) {
+    write_reconciled_parameters_(std::move(done));
+    return;
   }
-  ESP_LOGI(TAG, "Batch parameter response: %s", hex_buf);
   
-  // Based on the serial capture, each 4-byte value is returned sequentially
-  // The format should match what we saw in the capture
-  if (response.size() >= param_ids.size() * 4) {
-    values.clear();
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  for (size_t start = 0; start < unknown_ids.size(); start += MAX_BATCH_PARAMS) {
+    size_t end = std::min(unknown_ids.size(), start + MAX_BATCH_PARAMS);
+    std::vector<uint16_t> chunk(unknown_ids.begin() + start, unknown_ids.begin() + end);
+    bool last_chunk = end == unknown_ids.size();
+    
+    std::vector<uint32_t> args(chunk.begin(), chunk.end());
+    queue_command_(CMD_GET_PARAMS, args.data(), args.size(),
+                   [this, chunk, last_chunk, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+      std::vector<uint32_t> values;
+      if (!result.ok() || !parse_parameter_values_(payload, chunk, values)) {
+        // Unread slots stay invalid and are simply written below
+        ESP_LOGW(TAG, "Could not read %zu parameters, they will be written unconditionally", chunk.size());
+      }
+      if (last_chunk) {
+        write_reconciled_parameters_([done_ptr]() { (*done_ptr)(); });
+      }
+    });
+  }
+}
+
+void HLKLD2402Component::write_reconciled_parameters_(std::function<void()> &&done) {
+  reconcile_writes_pending_ = 0;
+  reconcile_written_ = 0;
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  
+  for (uint8_t slot = 0; slot < PARAM_SLOT_COUNT; slot++) {
+    uint64_t bit = 1ULL << slot;
+    if (!(desired_mask_ & bit))
+      continue;
+    if ((shadow_valid_mask_ & bit) && shadow_values_[slot] == desired_values_[slot])
+      continue;
     
-    for (size_t i = 0; i < param_ids.size(); i++) {
-      size_t offset = i * 4;
-      uint32_t value = response[offset] | 
-                      (response[offset+1] << 8) | 
-                      (response[offset+2] << 16) | 
-                      (response[offset+3] << 24);
+    uint16_t param_id = slot_param_id_(slot);
+    uint32_t value = desired_values_[slot];
+    ESP_LOGI(TAG, "Parameter 0x%04X differs from declared value %u, writing", param_id, value);
+    
+    reconcile_writes_pending_++;
+    queue_command_(CMD_SET_PARAMS, {param_id, value},
+                   [this, param_id, value, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+      if (result.ok()) {
+        update_shadow_(param_id, value, true);
+        reconcile_written_++;
+      } else {
+        ESP_LOGW(TAG, "Failed to write parameter 0x%04X: %s", param_id, result.describe());
+      }
       
-      values.push_back(value);
-      ESP_LOGI(TAG, "Parameter 0x%04X value: %u (0x%08X)", param_ids[i], value, value);
-    }
-    return true;
+      if (--reconcile_writes_pending_ > 0)
+        return;
+      
+      ESP_LOGI(TAG, "Parameter reconciliation: %u written", reconcile_written_);
+      if (reconcile_written_ == 0 || !has_unsaved_changes_()) {
+        (*done_ptr)();
+        return;
+      }
+      queue_command_(CMD_SAVE_PARAMS, {}, [this, done_ptr](const CommandResult &result, const std::vector<uint8_t> &payload) {
+        if (result.ok()) {
+          mark_saved_();
+        } else {
+          ESP_LOGW(TAG, "Reconciled parameters were written but could not be saved to flash");
+        }
+        (*done_ptr)();
+      });
+    });
   }
   
-  ESP_LOGE(TAG, "Invalid batch parameter response format or insufficient data");
-  return false;
+  if (reconcile_writes_pending_ == 0) {
+    ESP_LOGI(TAG, "Declared parameters already match the device");
+    (*done_ptr)();
+  }
 }
 
+#ifdef USE_HLK_LD2402_THRESHOLDS
 // Method to read all motion thresholds in one call
 bool HLKLD2402Component::get_all_motion_thresholds() {
   ESP_LOGI(TAG, "Reading all motion thresholds");
@@ -2260,26 +2607,7 @@ bool HLKLD2402Component::get_all_motion_thresholds() {
   bool success = get_parameters_batch_(param_ids, values);
   
   if (success) {
-    ESP_LOGI(TAG, "Motion thresholds for all gates:");
-    
-    // Resize the cache vector if needed
-    if (motion_threshold_values_.size() < values.size()) {
-      motion_threshold_values_.resize(values.size(), 0);
-    }
-    
-    // Process and publish each value
-    for (size_t i = 0; i < values.size() && i < 16; i++) {
-      float db_value = threshold_to_db_(values[i]);
-      motion_threshold_values_[i] = db_value;
-      
-      ESP_LOGI(TAG, "  Gate %d: %u (%.1f dB)", i, values[i], db_value);
-      
-      // Publish to sensor if available
-      if (i < motion_threshold_sensors_.size() && motion_threshold_sensors_[i] != nullptr) {
-        motion_threshold_sensors_[i]->publish_state(db_value);
-        ESP_LOGI(TAG, "Published motion threshold for gate %d: %.1f dB", i, db_value);
-      }
-    }
+    publish_thresholds_(false, values);
   }
   
   exit_config_mode_();
@@ -2305,43 +2633,73 @@ bool HLKLD2402Component::get_all_micromotion_thresholds() {
   bool success = get_parameters_batch_(param_ids, values);
   
   if (success) {
-    ESP_LOGI(TAG, "Micromotion thresholds for all gates:");
-    
-    // Resize the cache vector if needed
-    if (micromotion_threshold_values_.size() < values.size()) {
-      micromotion_threshold_values_.resize(values.size(), 0);
-    }
-    
-    // Process and publish each value
-    for (size_t i = 0; i < values.size() && i < 16; i++) {
-      float db_value = threshold_to_db_(values[i]);
-      micromotion_threshold_values_[i] = db_value;
-      
-      ESP_LOGI(TAG, "  Gate %d: %u (%.1f dB)", i, values[i], db_value);
-      
-      // Publish to sensor if available
-      if (i < micromotion_threshold_sensors_.size() && micromotion_threshold_sensors_[i] != nullptr) {
-        micromotion_threshold_sensors_[i]->publish_state(db_value);
-        ESP_LOGI(TAG, "Published micromotion threshold for gate %d: %.1f dB", i, db_value);
-      }
-    }
+    publish_thresholds_(true, values);
   }
   
   exit_config_mode_();
   return success;
 }
 
+// Publishes one batch of thresholds (gate 0 upwards) and caches them in dB
+void HLKLD2402Component::publish_thresholds_(bool micromotion, const std::vector<uint32_t> &values) {
+  float *cache = micromotion ? micromotion_threshold_values_ : motion_threshold_values_;
+  const ThresholdSensors &sensors = micromotion ? micromotion_threshold_sensors_ : motion_threshold_sensors_;
+  const char *kind = micromotion ? "micromotion" : "motion";
+  ESP_LOGI(TAG, "%s thresholds for all gates:", micromotion ? "Micromotion" : "Motion");
+  
+  // Process and publish each value
+  for (size_t i = 0; i < values.size() && i < THRESHOLD_GATES; i++) {
+    float db_value = threshold_to_db_(values[i]);
+    cache[i] = db_value;
+    
+    ESP_LOGI(TAG, "  Gate %zu: %u (%.1f dB)", i, values[i], db_value);
+    
+    // Publish to sensor if available
+    if (sensors.has(i)) {
+      sensors.slots[i]->publish_state(db_value);
+      ESP_LOGD(TAG, "Published %s threshold for gate %zu: %.1f dB", kind, i, db_value);
+    }
+  }
+}
+
+// Re-reads every motion and micromotion threshold (one batch read each), refreshing
+// the shadow and the threshold sensors. Must be queued inside an open config session.
+void HLKLD2402Component::queue_threshold_refresh_(std::function<void()> &&done) {
+  auto done_ptr = std::make_shared<std::function<void()>>(std::move(done));
+  for (bool micromotion : {false, true}) {
+    uint16_t base = micromotion ? PARAM_MICRO_THRESHOLD : PARAM_TRIGGER_THRESHOLD;
+    std::vector<uint16_t> param_ids;
+    for (uint16_t gate = 0; gate < THRESHOLD_GATES; gate++) {
+      param_ids.push_back(base + gate);
+    }
+    
+    std::vector<uint32_t> args(param_ids.begin(), param_ids.end());
+    queue_command_(CMD_GET_PARAMS, args.data(), args.size(),
+                   [this, micromotion, param_ids, done_ptr](const CommandResult &result,
+                                                            const std::vector<uint8_t> &payload) {
+      std::vector<uint32_t> values;
+      if (result.ok() && parse_parameter_values_(payload, param_ids, values)) {
+        publish_thresholds_(micromotion, values);
+      } else {
+        ESP_LOGW(TAG, "Could not refresh %s thresholds", micromotion ? "micromotion" : "motion");
+      }
+      if (micromotion) {
+        (*done_ptr)();
+      }
+    });
+  }
+}
+#endif
+
+#ifdef USE_HLK_LD2402_CALIBRATION
 // Update calibration to match new command format and improve progress tracking
 void HLKLD2402Component::calibrate() {
   calibrate_with_coefficients(3.0f, 3.0f, 3.0f);
 }
 
-// Update calibration to match new command format and improve progress tracking
 bool HLKLD2402Component::calibrate_with_coefficients(float trigger_coeff, float hold_coeff, float micromotion_coeff) {
-  ESP_LOGI(TAG, "Starting calibration with custom coefficients...");
-  
-  if (!enter_config_mode_()) {
-    ESP_LOGE(TAG, "Failed to enter config mode");
+  if (calibration_in_progress_) {
+    ESP_LOGW(TAG, "Calibration already running (%u%%)", calibration_progress_);
     return false;
   }
   
@@ -2355,38 +2713,115 @@ bool HLKLD2402Component::calibrate_with_coefficients(float trigger_coeff, float
   uint16_t hold_value = static_cast<uint16_t>(hold_coeff * 10.0f);
   uint16_t micro_value = static_cast<uint16_t>(micromotion_coeff * 10.0f);
   
-  // Prepare data according to the protocol: 3 coefficients, each 2 bytes
-  uint8_t data[] = {
-    static_cast<uint8_t>(trigger_value & 0xFF),
-    static_cast<uint8_t>((trigger_value >> 8) & 0xFF),
-    static_cast<uint8_t>(hold_value & 0xFF),
-    static_cast<uint8_t>((hold_value >> 8) & 0xFF),
-    static_cast<uint8_t>(micro_value & 0xFF),
-    static_cast<uint8_t>((micro_value >> 8) & 0xFF)
-  };
-  
-  ESP_LOGI(TAG, "Calibration coefficients - Trigger: %.1f, Hold: %.1f, Micro: %.1f", 
+  ESP_LOGI(TAG, "Starting calibration - Trigger: %.1f, Hold: %.1f, Micro: %.1f", 
          trigger_coeff, hold_coeff, micromotion_coeff);
   
-  if (send_command_(CMD_START_CALIBRATION, data, sizeof(data))) {
-    ESP_LOGI(TAG, "Started calibration with custom coefficients");
+  // Claimed now so the scheduler and the watchdog leave the queue alone
+  calibration_in_progress_ = true;
+  calibration_progress_ = 0;
+  queue_enter_config_([this, trigger_value, hold_value, micro_value](bool entered) {
+    if (!entered) {
+      ESP_LOGE(TAG, "Failed to enter config mode for calibration");
+      calibration_in_progress_ = false;
+      return;
+    }
+    
+    queue_command_(CMD_START_CALIBRATION, {trigger_value, hold_value, micro_value},
+                   [this](const CommandResult &result, const std::vector<uint8_t> &payload) {
+      if (!result) {
+        ESP_LOGE(TAG, "Failed to start calibration: %s", result.describe());
+        finish_calibration_(false);
+        return;
+      }
+      ESP_LOGI(TAG, "Calibration started");
+      
+      // Calibration regenerates every threshold, so the shadowed values are stale now
+      unshadowed_changes_ = true;
+      for (uint8_t gate = 0; gate < THRESHOLD_GATES; gate++) {
+        shadow_valid_mask_ &= ~(1ULL << (PARAM_SLOT_MOTION_BASE + gate));
+        shadow_valid_mask_ &= ~(1ULL << (PARAM_SLOT_MICRO_BASE + gate));
+      }
+      
+      calibration_started_at_ = millis();
+      last_calibration_check_ = calibration_started_at_;
+      if (this->calibration_progress_sensor_ != nullptr) {
+        this->calibration_progress_sensor_->publish_state(0);
+      }
+    });
+  });
+  return true;
+}
+
+// Polls the progress every calibration_poll_interval_ through the async queue
+void HLKLD2402Component::run_calibration_() {
+  if (!calibration_in_progress_ || command_queue_busy_())
+    return;
+  if (!config_mode_) {
+    // Something else closed the session; the module has left calibration with it
+    ESP_LOGW(TAG, "Config mode closed during calibration, stopping progress tracking");
+    calibration_in_progress_ = false;
+    return;
+  }
+  
+  uint32_t now = millis();
+  if (now - calibration_started_at_ > calibration_timeout_ms_) {
+    ESP_LOGW(TAG, "Calibration did not finish within %u s (last progress %u%%)", calibration_timeout_ms_ / 1000,
+             calibration_progress_);
+    finish_calibration_(false);
+    return;
+  }
+  if (now - last_calibration_check_ < calibration_poll_interval_ms_)
+    return;
+  last_calibration_check_ = now;
+  
+  queue_command_(CMD_GET_CALIBRATION_STATUS, {}, [this](const CommandResult &result, const std::vector<uint8_t> &payload) {
+    if (!result) {
+      // Keep polling; the calibration timeout ends a module that stopped answering
+      ESP_LOGW(TAG, "Calibration status query failed: %s", result.describe());
+      return;
+    }
     
-    // Set calibration flags and initialize progress
-    calibration_in_progress_ = true;
-    calibration_progress_ = 0;
-    last_calibration_check_ = millis() - 4000; // Check status almost immediately
+    // ACK carries the progress (0-100) as 2 bytes after the status
+    uint16_t progress = payload[0] | (payload[1] << 8);
+    if (progress > 100) {
+      ESP_LOGW(TAG, "Invalid calibration progress value: %u, capping to 100", progress);
+      progress = 100;
+    }
     
-    // Publish initial progress
-    if (this->calibration_progress_sensor_ != nullptr) {
-      this->calibration_progress_sensor_->publish_state(0);
+    if (progress != calibration_progress_) {
+      calibration_progress_ = progress;
+      ESP_LOGI(TAG, "Calibration progress: %u%%", progress);
+      if (this->calibration_progress_sensor_ != nullptr) {
+        this->calibration_progress_sensor_->publish_state(progress);
+      }
     }
-    return true;
-  } else {
-    ESP_LOGE(TAG, "Failed to start calibration");
-    exit_config_mode_();
-    return false;
+    
+    if (progress >= 100) {
+      finish_calibration_(true);
+    }
+  });
+}
+
+// Ends the calibration session. On success the new thresholds are read back while
+// config mode is still open, so shadow and sensors match the module without a manual read.
+void HLKLD2402Component::finish_calibration_(bool completed) {
+  auto leave = [this]() {
+    queue_exit_config_([this]() { calibration_in_progress_ = false; });
+  };
+  if (!completed) {
+    leave();
+    return;
   }
+  
+#ifdef USE_HLK_LD2402_THRESHOLDS
+  ESP_LOGI(TAG, "Calibration complete after %u s, reading new thresholds", (millis() - calibration_started_at_) / 1000);
+  queue_threshold_refresh_(std::move(leave));
+#else
+  ESP_LOGI(TAG, "Calibration complete after %u s", (millis() - calibration_started_at_) / 1000);
+  leave();
+#endif
 }
+#endif
 
 }  // namespace hlk_ld2402
 }  // namespace esphome
\ No newline at end of file
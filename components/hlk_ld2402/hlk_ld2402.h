@@ -1,22 +1,95 @@
 #pragma once
 
+#include "esphome/core/automation.h"
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
 #include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/uart/uart.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"  // Include without condition
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+
 namespace esphome {
 namespace hlk_ld2402 {
 
-static const uint8_t FRAME_HEADER[] = {0xFD, 0xFC, 0xFB, 0xFA};
-static const uint8_t FRAME_FOOTER[] = {0x04, 0x03, 0x02, 0x01};
+static constexpr uint8_t FRAME_HEADER[] = {0xFD, 0xFC, 0xFB, 0xFA};
+static constexpr uint8_t FRAME_FOOTER[] = {0x04, 0x03, 0x02, 0x01};
 
 // Add new frame format constants
 static const uint8_t DATA_FRAME_HEADER[] = {0xF4, 0xF3, 0xF2, 0xF1}; // Data frame header
-static const uint8_t DATA_FRAME_TYPE_DISTANCE = 0x83; // Distance data frame type
-static const uint8_t DATA_FRAME_TYPE_ENGINEERING = 0x84; // Engineering data frame type
+static const uint8_t DATA_FRAME_TYPE_DISTANCE = 0x83; // Handler key of the measurement frame, see the layout below
+static const uint8_t DATA_FRAME_FOOTER[] = {0xF8, 0xF7, 0xF6, 0xF5}; // Data frame footer
+
+// Stream demultiplexer: headers are matched as a rolling 32-bit window
+static const uint32_t COMMAND_HEADER_WORD = 0xFDFCFBFA;
+static const uint32_t DATA_HEADER_WORD = 0xF4F3F2F1;
+static const size_t MAX_DATA_FRAME_SIZE = 256;  // Header + length word + body + footer
+
+// Data frames are decoded by handlers registered per frame type and stream mode.
+// Types 0x80-0x8F are indexable; anything else is counted as unknown.
+enum class StreamMode : uint8_t { NORMAL, ENGINEERING };
+static const uint8_t STREAM_MODE_COUNT = 2;
+static const uint8_t DATA_FRAME_TYPE_BASE = 0x80;
+static const uint8_t DATA_FRAME_TYPE_SLOTS = 16;
+static const uint8_t MAX_DATA_FRAME_HANDLERS = 4;
+
+// Data frame layout, offsets from the start of the header:
+//   header F4 F3 F2 F1 (4) | length (2, LE) | status (1) | distance cm (2, LE) | payload | footer
+// The length counts status, distance and payload. Status is 0 for no target, 1 for a moving
+// and 2 for a stationary one; the payload holds the gate energies, see EngineeringFrame.
+// There is no type byte. The module sends one layout, with 16 gates per bank, so frames are
+// recognised by that exact length and dispatched as DATA_FRAME_TYPE_DISTANCE.
+static const size_t DATA_FRAME_LENGTH_OFFSET = 4;
+static const size_t DATA_FRAME_STATUS_OFFSET = 6;
+static const size_t DATA_FRAME_DISTANCE_OFFSET = 7;
+static const size_t DATA_FRAME_PAYLOAD_OFFSET = 9;
+static const size_t DATA_FRAME_FIXED_BYTES = DATA_FRAME_PAYLOAD_OFFSET - DATA_FRAME_STATUS_OFFSET;  // Counted in the length
+static const uint16_t DATA_FRAME_MEASUREMENT_LENGTH = DATA_FRAME_FIXED_BYTES + 2 * 16 * 4;
+
+// Read-only view of a data frame (header included, footer stripped) whose size has been
+// checked against the handler's minimum, so handlers can index without re-validating.
+struct DataFrameView {
+  const uint8_t *data;
+  size_t length;
+  
+  constexpr size_t size() const { return length; }
+  constexpr uint8_t operator[](size_t i) const { return data[i]; }
+  constexpr uint16_t u16(size_t offset) const { return data[offset] | (data[offset + 1] << 8); }
+  constexpr uint32_t u32(size_t offset) const {
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (static_cast<uint32_t>(data[offset + 3]) << 24);
+  }
+  constexpr uint16_t length_field() const { return u16(DATA_FRAME_LENGTH_OFFSET); }
+  constexpr uint8_t status() const { return data[DATA_FRAME_STATUS_OFFSET]; }
+  constexpr uint16_t distance_cm() const { return u16(DATA_FRAME_DISTANCE_OFFSET); }
+  // Received size matches the length field; the demux strips only the footer
+  constexpr bool length_matches() const { return length == DATA_FRAME_STATUS_OFFSET + length_field(); }
+  // Handler key from the frame's length; 0 (no handler) for any other layout
+  constexpr uint8_t type() const {
+    return length_matches() && length_field() == DATA_FRAME_MEASUREMENT_LENGTH ? DATA_FRAME_TYPE_DISTANCE : 0;
+  }
+};
+
+// Decode check against a reference engineering frame: a moving target at 150 cm, motion
+// gate 0 at 10000, the other 31 energies zero (zero-filled by the initialiser)
+static constexpr uint8_t REFERENCE_DATA_FRAME[DATA_FRAME_STATUS_OFFSET + DATA_FRAME_MEASUREMENT_LENGTH] = {
+  0xF4, 0xF3, 0xF2, 0xF1, 0x83, 0x00, 0x01, 0x96, 0x00, 0x10, 0x27, 0x00, 0x00,
+};
+static constexpr DataFrameView REFERENCE_DATA_FRAME_VIEW{REFERENCE_DATA_FRAME, sizeof(REFERENCE_DATA_FRAME)};
+static_assert(REFERENCE_DATA_FRAME_VIEW.type() == DATA_FRAME_TYPE_DISTANCE, "measurement frames are recognised by length");
+static_assert(REFERENCE_DATA_FRAME_VIEW.length_matches(), "length field counts from the status byte");
+static_assert(REFERENCE_DATA_FRAME_VIEW.status() == 1 && REFERENCE_DATA_FRAME_VIEW.distance_cm() == 150,
+              "status and distance follow the length field");
+static_assert(REFERENCE_DATA_FRAME_VIEW.u32(DATA_FRAME_PAYLOAD_OFFSET) == 10000, "energies follow the distance");
+static const uint32_t LINE_LOG_INTERVAL_MS = 2000;  // Received text lines are logged at INFO this often
 
 // Commands
 static const uint16_t CMD_GET_VERSION = 0x0000;  // Read firmware version command
@@ -40,6 +113,19 @@ static const uint16_t PARAM_TIMEOUT = 0x0004;  // Target disappearance delay
 static const uint16_t PARAM_POWER_INTERFERENCE = 0x0005;  // Power interference status (read-only)
 static const uint16_t PARAM_TRIGGER_THRESHOLD = 0x0010;  // Motion trigger threshold base (0x0010-0x001F)
 static const uint16_t PARAM_MICRO_THRESHOLD = 0x0030;  // Micromotion threshold base (0x0030-0x003F)
+static const uint8_t THRESHOLD_GATES = 16;  // Threshold parameters exist for gates 0-15
+
+// Shadow slots for writable parameters: max distance, timeout, then both threshold banks
+static const uint8_t PARAM_SLOT_MAX_DISTANCE = 0;
+static const uint8_t PARAM_SLOT_TIMEOUT = 1;
+static const uint8_t PARAM_SLOT_MOTION_BASE = 2;
+static const uint8_t PARAM_SLOT_MICRO_BASE = PARAM_SLOT_MOTION_BASE + THRESHOLD_GATES;
+static const uint8_t PARAM_SLOT_COUNT = PARAM_SLOT_MICRO_BASE + THRESHOLD_GATES;
+static const uint8_t MAX_BATCH_PARAMS = 16;  // Largest parameter read the module answers reliably
+
+// Largest command frame is the ACK of a full batch read: length word + command word +
+// status word + one 32-bit value per parameter + footer
+static const size_t MAX_COMMAND_FRAME_SIZE = 2 + 2 + 2 + 4 * MAX_BATCH_PARAMS + 4;
 
 // Work modes
 static const uint32_t MODE_PRODUCTION = 0x00000064;  // Normal production mode
@@ -47,6 +133,171 @@ static const uint32_t MODE_NORMAL = 0x00000064;  // Alias for production mode
 static const uint32_t MODE_CONFIG = 0x00000001;
 static const uint32_t MODE_ENGINEERING = 0x00000004;  // Engineering/debug mode
 
+// Command descriptors. Every command the component sends has one row here and the
+// generic encoder/decoder is driven entirely by it, so adding a command means adding a row.
+enum class PayloadLayout : uint8_t {
+  NONE,          // No command value
+  MODE,          // 0x0000 + mode (4 bytes)
+  PARAM_IDS,     // Parameter IDs, 2 bytes each
+  PARAM_WRITE,   // Parameter ID (2 bytes) + value (4 bytes)
+  COEFFICIENTS,  // Three coefficients x10, 2 bytes each
+};
+
+// What follows the status word of a successful ACK
+enum class AckLayout : uint8_t {
+  STATUS,           // Nothing
+  FIXED,            // At least ack_size bytes
+  PER_ARG,          // ack_size bytes per command argument (parameter values)
+  LENGTH_PREFIXED,  // Length (2 bytes) + that many bytes (version, SN)
+  NOTIFICATION,     // Sent by the module on its own, no status word
+};
+
+struct CommandDescriptor {
+  uint16_t opcode;
+  const char *name;
+  PayloadLayout payload;
+  uint8_t max_args;
+  AckLayout ack;
+  uint8_t ack_size;
+  uint16_t timeout_ms;
+  bool needs_config;
+  bool ack_optional;  // Some firmware versions never answer
+};
+
+static constexpr CommandDescriptor COMMAND_TABLE[] = {
+  // opcode                      name                   payload                      args ack                         size timeout config optional
+  {CMD_GET_VERSION,              "get version",         PayloadLayout::NONE,         0,   AckLayout::LENGTH_PREFIXED, 0,   1000,   true,  false},
+  {CMD_ENABLE_CONFIG,            "enable config",       PayloadLayout::NONE,         0,   AckLayout::FIXED,           4,   1000,   false, false},
+  {CMD_DISABLE_CONFIG,           "disable config",      PayloadLayout::NONE,         0,   AckLayout::STATUS,          0,   300,    true,  true},
+  {CMD_GET_SN_HEX,               "get SN (hex)",        PayloadLayout::NONE,         0,   AckLayout::LENGTH_PREFIXED, 0,   1000,   true,  false},
+  {CMD_GET_SN_CHAR,              "get SN (char)",       PayloadLayout::NONE,         0,   AckLayout::LENGTH_PREFIXED, 0,   1000,   true,  false},
+  {CMD_GET_PARAMS,               "get parameters",      PayloadLayout::PARAM_IDS,    16,  AckLayout::PER_ARG,         4,   2000,   true,  false},
+  {CMD_SET_PARAMS,               "set parameter",       PayloadLayout::PARAM_WRITE,  2,   AckLayout::STATUS,          0,   1000,   true,  false},
+  {CMD_SET_MODE,                 "set mode",            PayloadLayout::MODE,         1,   AckLayout::STATUS,          0,   2000,   true,  false},
+  {CMD_START_CALIBRATION,        "start calibration",   PayloadLayout::COEFFICIENTS, 3,   AckLayout::STATUS,          0,   1000,   true,  false},
+  {CMD_GET_CALIBRATION_STATUS,   "calibration status",  PayloadLayout::NONE,         0,   AckLayout::FIXED,           2,   1000,   true,  false},
+  {CMD_SAVE_PARAMS,              "save parameters",     PayloadLayout::NONE,         0,   AckLayout::STATUS,          0,   3000,   true,  false},
+  {CMD_AUTO_GAIN,                "auto gain",           PayloadLayout::NONE,         0,   AckLayout::STATUS,          0,   1000,   true,  false},
+  {CMD_AUTO_GAIN_COMPLETE,       "auto gain complete",  PayloadLayout::NONE,         0,   AckLayout::NOTIFICATION,    0,   10000,  false, false},
+};
+
+constexpr const CommandDescriptor *find_command(uint16_t opcode) {
+  for (const CommandDescriptor &desc : COMMAND_TABLE) {
+    if (desc.opcode == opcode)
+      return &desc;
+  }
+  return nullptr;
+}
+
+static_assert(find_command(CMD_SET_MODE)->payload == PayloadLayout::MODE, "Command table lookup is broken");
+
+// Largest ACK frame the table allows for commands whose ACK grows with the argument count
+constexpr size_t max_per_arg_ack_frame() {
+  size_t largest = 0;
+  for (const CommandDescriptor &desc : COMMAND_TABLE) {
+    size_t frame = 2 + 2 + 2 + size_t(desc.ack_size) * desc.max_args + 4;
+    if (desc.ack == AckLayout::PER_ARG && frame > largest)
+      largest = frame;
+  }
+  return largest;
+}
+static_assert(max_per_arg_ack_frame() <= MAX_COMMAND_FRAME_SIZE,
+              "a full batch read ACK would be dropped as an implausible command frame");
+static_assert(find_command(CMD_GET_PARAMS)->max_args >= MAX_BATCH_PARAMS,
+              "batch reads are split into MAX_BATCH_PARAMS chunks the descriptor must accept");
+
+static const size_t COMMAND_COUNT = sizeof(COMMAND_TABLE) / sizeof(COMMAND_TABLE[0]);
+
+// Why a command failed
+enum class CommandError : uint8_t {
+  NONE,
+  TIMEOUT,        // No ACK within the timeout
+  NAK,            // ACK with a non-zero status word
+  MALFORMED,      // ACK shorter than its descriptor requires
+  NOT_IN_CONFIG,  // Command needs config mode
+  BUSY,           // Background commands still running
+  INVALID,        // Unknown opcode or wrong arguments
+  UNAVAILABLE,    // Circuit breaker open, radar considered unresponsive
+};
+static const uint8_t COMMAND_ERROR_COUNT = 8;
+static const char *const COMMAND_ERROR_NAMES[COMMAND_ERROR_COUNT] = {
+  "ok", "timeout", "NAK", "malformed ACK", "not in config mode", "busy", "invalid request", "radar unresponsive",
+};
+
+// Retry/backoff policy shared by every device transaction. Only timeouts and malformed
+// ACKs are retried; a NAK is the module's answer and is returned as is.
+struct RetryPolicy {
+  uint8_t attempts;        // Total tries including the first
+  uint32_t base_delay_ms;  // Delay before the first retry, doubled for each further one
+  uint32_t jitter_ms;      // Random extra delay so retries don't line up with the module's own cycles
+  uint32_t deadline_ms;    // No retry starts later than this after the first try
+};
+static const RetryPolicy DEFAULT_RETRY_POLICY{3, 250, 100, 5000};
+
+// Circuit breaker: after this many consecutive timeouts commands fail fast for the cooldown.
+// Once it has passed the breaker is half-open: one command goes out as a probe and the rest
+// wait for its result, which closes the breaker or opens it for another cooldown.
+enum class BreakerState : uint8_t { CLOSED, OPEN, HALF_OPEN };
+static const uint8_t DEFAULT_BREAKER_THRESHOLD = 6;
+static const uint32_t DEFAULT_BREAKER_COOLDOWN_MS = 60000;
+
+struct CommandResult {
+  CommandError error{CommandError::NONE};
+  uint16_t status{0};      // Raw ACK status word, non-zero for a NAK
+  uint32_t elapsed_ms{0};  // Send to ACK (or to giving up)
+  
+  bool ok() const { return error == CommandError::NONE; }
+  explicit operator bool() const { return ok(); }
+  const char *describe() const { return COMMAND_ERROR_NAMES[static_cast<uint8_t>(error)]; }
+};
+
+// Stream watchdog. Silence longer than a multiple of the learned frame/line cadence is a
+// stall; each further stall period escalates to the next, more intrusive recovery step.
+enum class RecoveryStep : uint8_t {
+  RESYNC_PARSER,  // Drop partial frames and restart header matching
+  EXIT_CONFIG,    // Module may be stuck in config mode without us knowing
+  REISSUE_MODE,   // Set the current work mode again
+  UART_REINIT,    // Reapply the UART settings
+};
+static const uint8_t RECOVERY_STEP_COUNT = 4;
+static const char *const RECOVERY_STEP_NAMES[RECOVERY_STEP_COUNT] = {
+  "resync parser", "exit config", "re-issue mode", "UART reinit",
+};
+static const uint32_t DEFAULT_STALL_TIMEOUT_MS = 10000;  // Upper bound, also used until a cadence is known
+static const uint32_t WATCHDOG_MIN_STALL_MS = 2000;
+static const uint32_t WATCHDOG_CADENCE_FACTOR = 8;
+static const uint8_t WATCHDOG_MAX_BACKOFF_SHIFT = 5;     // Later ladder rounds wait up to 32x longer per step
+static const uint8_t DESYNC_LIMIT = 5;                   // Dropped frames per stall window that force a resync
+static const uint32_t CONFIG_IDLE_LIMIT_MS = 30000;      // Config mode with no command activity
+
+// Unsolicited command-channel frames are dispatched to handlers registered per opcode.
+// Every opcode the module uses fits in one byte, so the lookup is a single table index.
+static const uint8_t MAX_NOTIFICATION_HANDLERS = 4;
+static const uint16_t NOTIFICATION_OPCODE_LIMIT = 0x100;
+
+enum class AutoGainState : uint8_t {
+  IDLE,
+  RUNNING,    // Command acknowledged, waiting for the 0x00F0 completion notification
+  COMPLETE,
+  TIMED_OUT,
+  FAILED,
+};
+static const char *const AUTO_GAIN_STATE_NAMES[] = {"Idle", "Running", "Complete", "Timed out", "Failed"};
+
+// Adaptive ACK timing. Waits end as soon as the ACK arrives; once enough latencies are
+// known the timeout shrinks to a multiple of the observed p99, never above the table value.
+static const uint8_t LATENCY_SAMPLES = 16;
+static const uint8_t LATENCY_MIN_SAMPLES = 4;
+static const uint32_t LATENCY_TIMEOUT_FACTOR = 3;
+static const uint32_t LATENCY_TIMEOUT_FLOOR_MS = 100;
+
+// Latencies are learned per unit of work: one per parameter for commands whose ACK grows with
+// the argument count (batch reads), one otherwise, so a 16-parameter read waits 16x as long
+// as a single one instead of inheriting its timeout
+constexpr uint8_t latency_units(const CommandDescriptor &desc, size_t arg_count) {
+  return desc.ack == AckLayout::PER_ARG && arg_count > 1 ? static_cast<uint8_t>(arg_count) : 1;
+}
+
 // Update - Correct baud rate according to manual
 static const uint32_t UART_BAUD_RATE = 115200;
 static const uint8_t UART_STOP_BITS = 1;
@@ -61,24 +312,397 @@ static constexpr float STATIC_RANGE = 5.0f;            // Max 5m for static dete
 static constexpr float DISTANCE_PRECISION = 0.15f;     // ±0.15m accuracy
 static constexpr float DISTANCE_GATE_SIZE = 0.7f;      // 0.7m per gate
 static const uint8_t MAX_GATES = 32;                   // Hardware maximum gates
-static const uint8_t DEFAULT_GATES = 15;               // Update to 15 to match your configuration
+static const uint8_t GATES_PER_BANK = THRESHOLD_GATES; // Gates per energy bank in engineering frames
+
+// Gates within max_distance, computed by codegen. Energy decoding, caches and gate sensor
+// tables are sized by it, so gates beyond the configured range cost neither RAM nor cycles.
+#ifndef HLK_LD2402_GATES
+#define HLK_LD2402_GATES 16  // max_distance not declared: the module may use all of them
+#endif
+static constexpr uint8_t ACTIVE_GATES = HLK_LD2402_GATES;
+static_assert(ACTIVE_GATES >= 1 && ACTIVE_GATES <= GATES_PER_BANK, "HLK_LD2402_GATES must be 1-16");
+
+// Gate edges in metres, computed at compile time instead of per gate and frame
+template<size_t N> constexpr std::array<float, N> make_gate_edges(float offset_m) {
+  std::array<float, N> edges{};
+  for (size_t i = 0; i < N; i++)
+    edges[i] = i * DISTANCE_GATE_SIZE + offset_m;
+  return edges;
+}
+static constexpr std::array<float, ACTIVE_GATES> GATE_START_M = make_gate_edges<ACTIVE_GATES>(0.0f);
+static constexpr std::array<float, ACTIVE_GATES> GATE_END_M = make_gate_edges<ACTIVE_GATES>(DISTANCE_GATE_SIZE);
+
+// Bulk decode of count little-endian 32-bit words. All supported targets are little
+// endian, so this is a single memcpy the compiler can widen; src needs no alignment.
+inline void decode_le32_array(const uint8_t *src, size_t count, uint32_t *out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(out, src, count * sizeof(uint32_t));
+#else
+  for (size_t i = 0; i < count; i++, src += 4)
+    out[i] = src[0] | (src[1] << 8) | (src[2] << 16) | (static_cast<uint32_t>(src[3]) << 24);
+#endif
+}
+
+// One frame's gate energies as structure of arrays, so each pass runs over one array
+struct GateEnergies {
+  uint8_t count{0};
+  uint32_t raw[ACTIVE_GATES]{};
+  float db[ACTIVE_GATES]{};
+};
+
+// Engineering frame payload (see the data frame layout): motion energies | micromotion energies.
+// Both banks hold the same number of 4-byte LE values, (length - 3) / 8 gates each;
+// the module sends 16 per bank, matching its 16 threshold parameters per bank. Only the
+// first ACTIVE_GATES of each bank are decoded.
+static const size_t ENGINEERING_MIN_FRAME = DATA_FRAME_PAYLOAD_OFFSET + 2 * 4;
+static_assert((REFERENCE_DATA_FRAME_VIEW.length_field() - DATA_FRAME_FIXED_BYTES) / 8 == GATES_PER_BANK,
+              "a 0x83 frame carries 16 gates per bank");
+
+// Per-gate entities in fixed slots plus a bitmask of the configured ones, so publish
+// loops visit configured gates only and registration never allocates
+using GateMask = uint16_t;
+static_assert(sizeof(GateMask) * 8 >= THRESHOLD_GATES, "GateMask too narrow for the gates");
+
+template<uint8_t N> struct GateSlots {
+  std::array<sensor::Sensor *, N> slots{};
+  GateMask configured{0};
+  
+  bool set(uint8_t gate, sensor::Sensor *sensor) {
+    if (gate >= N)
+      return false;
+    slots[gate] = sensor;
+    configured |= GateMask(1) << gate;
+    return true;
+  }
+  bool has(uint8_t gate) const { return gate < N && (configured >> gate) & 1; }
+  uint8_t count() const { return __builtin_popcount(configured); }
+};
+// Energies are decoded for the active gates only; threshold parameters exist for every gate
+using GateSensors = GateSlots<ACTIVE_GATES>;
+using ThresholdSensors = GateSlots<THRESHOLD_GATES>;
+
+// Throttled sensors publish one statistic of all samples seen since their last publish,
+// instead of whichever sample happens to arrive when the throttle expires
+enum class Aggregation : uint8_t { LAST, MIN, MAX, MEAN, COUNT };
+
+// Running aggregate in constant space: only what the chosen statistic needs is kept
+struct WindowAggregate {
+  float value{0.0f};
+  uint16_t count{0};
+  
+  void add(float sample, Aggregation mode) {
+    if (count < UINT16_MAX)
+      count++;
+    switch (mode) {
+      case Aggregation::LAST: value = sample; break;
+      case Aggregation::MIN: value = count == 1 ? sample : std::min(value, sample); break;
+      case Aggregation::MAX: value = count == 1 ? sample : std::max(value, sample); break;
+      case Aggregation::MEAN: value = count == 1 ? sample : value + (sample - value) / count; break;
+      case Aggregation::COUNT: break;
+    }
+  }
+  float result(Aggregation mode) const { return mode == Aggregation::COUNT ? count : value; }
+  void reset() { count = 0; }
+};
+
+// Sliding median over the last `size` distance samples, which drops single-frame outliers.
+// The ring keeps arrival order for eviction and a sorted copy gives the median; at this
+// window size a binary search plus a short memmove beats a heap pair or a tree.
+static constexpr uint8_t MAX_MEDIAN_WINDOW = 9;
+struct SlidingMedian {
+  uint8_t size{5};
+  uint8_t count{0};
+  uint8_t head{0};  // Oldest sample once the ring is full
+  float ring[MAX_MEDIAN_WINDOW]{};
+  float sorted[MAX_MEDIAN_WINDOW]{};
+  
+  float add(float sample) {
+    if (count == size) {
+      float *oldest = std::lower_bound(sorted, sorted + count, ring[head]);
+      memmove(oldest, oldest + 1, (sorted + count - oldest - 1) * sizeof(float));
+      count--;
+      ring[head] = sample;
+      head = (head + 1) % size;
+    } else {
+      ring[count] = sample;  // head stays 0 until the ring is full
+    }
+    float *slot = std::upper_bound(sorted, sorted + count, sample);
+    memmove(slot + 1, slot, (sorted + count - slot) * sizeof(float));
+    *slot = sample;
+    count++;
+    return sorted[count / 2];
+  }
+  void reset() { count = head = 0; }
+};
+
+// Fixed-gain alpha-beta tracker on the median output: smoothed distance plus velocity in cm/s.
+// A gap longer than DISTANCE_TRACK_TIMEOUT_MS restarts it, since the target may have changed.
+static constexpr uint32_t DISTANCE_TRACK_TIMEOUT_MS = 3000;
+struct AlphaBetaTracker {
+  float alpha{0.5f};
+  float beta{0.1f};
+  float position{0.0f};
+  float velocity{0.0f};  // Positive while the target moves away
+  uint32_t updated_at{0};
+  bool tracking{false};
+  
+  float update(float measured, uint32_t now) {
+    uint32_t elapsed_ms = now - updated_at;
+    if (!tracking || elapsed_ms > DISTANCE_TRACK_TIMEOUT_MS) {
+      position = measured;
+      velocity = 0.0f;
+      tracking = true;
+      updated_at = now;
+      return position;
+    }
+    if (elapsed_ms == 0) {
+      // Same millisecond: no usable dt, so only pull the position towards the sample
+      position += alpha * (measured - position);
+      return position;
+    }
+    float dt = elapsed_ms / 1000.0f;
+    float predicted = position + velocity * dt;
+    float residual = measured - predicted;
+    position = predicted + alpha * residual;
+    velocity += beta * residual / dt;
+    updated_at = now;
+    return position;
+  }
+  void reset() {
+    tracking = false;
+    velocity = 0.0f;
+  }
+};
+
+// Change-based publishing of gate energies. Each gate publishes when its value leaves the
+// band around what it last published, or when its heartbeat is due.
+struct DeadbandPolicy {
+  float absolute;         // dB
+  float relative;         // Fraction of the last published value; the wider band applies
+  uint32_t heartbeat_ms;  // Longest time between publishes, 0 = only on change
+};
+static const DeadbandPolicy DEFAULT_ENERGY_DEADBAND{1.0f, 0.0f, 60000};
+static const uint32_t DEFAULT_ENGINEERING_THROTTLE_MS = 2000;
+
+// Target class from the detection status byte of distance frames
+enum class TargetState : uint8_t { NONE = 0, MOVING = 1, STATIONARY = 2 };
+
+// Debounced presence decision. A new target class is adopted after enter_frames consecutive
+// frames report it, and a lost target is only dropped after hold_ms without any. With a range
+// set, targets are admitted within range_cm and kept out to range_cm + hysteresis_cm.
+struct PresencePolicy {
+  uint8_t enter_frames;
+  uint32_t hold_ms;
+  float range_cm;  // 0 leaves the range to the module's max_distance
+  float hysteresis_cm;
+};
+static const PresencePolicy DEFAULT_PRESENCE_POLICY{2, 5000, 0.0f, 2 * DISTANCE_PRECISION * 100};
+
+struct GatePublishState {
+  float last[ACTIVE_GATES]{};
+  uint32_t at[ACTIVE_GATES]{};
+  GateMask published{0};
+  
+  bool due(uint8_t gate, float value, uint32_t now, const DeadbandPolicy &policy) const {
+    if (!((published >> gate) & 1))
+      return true;
+    if (policy.heartbeat_ms > 0 && now - at[gate] >= policy.heartbeat_ms)
+      return true;
+    float band = std::max(policy.absolute, policy.relative * fabsf(last[gate]));
+    return fabsf(value - last[gate]) > band;
+  }
+  void mark(uint8_t gate, float value, uint32_t now) {
+    last[gate] = value;
+    at[gate] = now;
+    published |= GateMask(1) << gate;
+  }
+};
+
+struct EngineeringFrame {
+  uint8_t status{0};        // 0 nobody, 1 moving target, 2 stationary target
+  uint16_t distance_cm{0};
+  GateEnergies motion;
+  GateEnergies micromotion;
+};
+
+// Fast 10*log10(raw) for energies and thresholds, without libm. log2(raw) is the index of
+// the top bit plus log2 of the mantissa, which is looked up from its next 6 bits; table
+// entries are taken at the middle of each bucket. Values are in 1/10000 dB.
+// Error against 10*log10f(): at most 0.034 dB over the whole uint32 range (0 maps to 0).
+static const uint32_t DB_PER_OCTAVE_E4 = 30103;  // 10*log10(2)
+static const uint8_t DB_MANTISSA_BITS = 6;
+static const uint16_t DB_MANTISSA_E4[1 << DB_MANTISSA_BITS] = {
+    338,  1006,  1664,  2312,  2951,  3580,  4201,  4813,
+   5416,  6011,  6598,  7177,  7748,  8312,  8869,  9419,
+   9962, 10498, 11027, 11551, 12068, 12579, 13084, 13583,
+  14076, 14564, 15047, 15524, 15996, 16463, 16925, 17382,
+  17835, 18282, 18726, 19164, 19599, 20029, 20454, 20876,
+  21294, 21707, 22117, 22523, 22925, 23323, 23718, 24109,
+  24497, 24882, 25263, 25640, 26015, 26386, 26754, 27119,
+  27481, 27840, 28196, 28549, 28899, 29246, 29591, 29933,
+};
+
+inline float fast_energy_db(uint32_t raw) {
+  if (raw == 0)
+    return 0.0f;
+  uint32_t msb = 31 - __builtin_clz(raw);
+  uint32_t mantissa = msb >= DB_MANTISSA_BITS ? raw >> (msb - DB_MANTISSA_BITS) : raw << (DB_MANTISSA_BITS - msb);
+  uint32_t db_e4 = msb * DB_PER_OCTAVE_E4 + DB_MANTISSA_E4[mantissa & ((1 << DB_MANTISSA_BITS) - 1)];
+  return db_e4 * 0.0001f;
+}
+
+// Startup: how long to listen for measurement output before normalising the module
+static const uint32_t STARTUP_LISTEN_MS = 1000;
+static const size_t MAX_COMMAND_PAYLOAD = 40;  // Enough for a 16-parameter batch read
+
+// Command frame encoder: header (4) + length (2) + command (2) + value + footer (4).
+// Usable at compile time, so commands without a value are sent from constant frames.
+// Only encoding is allocation-free; the command queue below still allocates.
+static const size_t FRAME_OVERHEAD = 12;
+static const size_t MAX_FRAME_SIZE = FRAME_OVERHEAD + MAX_COMMAND_PAYLOAD;
+using FixedFrame = std::array<uint8_t, FRAME_OVERHEAD>;
+
+// out must hold FRAME_OVERHEAD + len bytes; returns the frame size
+constexpr size_t encode_frame(uint16_t command, const uint8_t *data, size_t len, uint8_t *out) {
+  size_t pos = 0;
+  for (uint8_t b : FRAME_HEADER)
+    out[pos++] = b;
+  out[pos++] = (2 + len) & 0xFF;
+  out[pos++] = ((2 + len) >> 8) & 0xFF;
+  out[pos++] = command & 0xFF;
+  out[pos++] = (command >> 8) & 0xFF;
+  for (size_t i = 0; i < len; i++)
+    out[pos++] = data[i];
+  for (uint8_t b : FRAME_FOOTER)
+    out[pos++] = b;
+  return pos;
+}
+
+constexpr FixedFrame make_fixed_frame(uint16_t command) {
+  FixedFrame frame{};
+  encode_frame(command, nullptr, 0, frame.data());
+  return frame;
+}
+
+template<uint16_t Command> struct CommandFrame {
+  static constexpr FixedFrame value = make_fixed_frame(Command);
+};
+
+constexpr bool frame_equals(const FixedFrame &a, const FixedFrame &b) {
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i] != b[i])
+      return false;
+  }
+  return true;
+}
+
+// Byte-exact checks of the encoder against frames written out by hand from the protocol description
+static_assert(frame_equals(CommandFrame<CMD_ENABLE_CONFIG>::value,
+                           FixedFrame{0xFD, 0xFC, 0xFB, 0xFA, 0x02, 0x00, 0xFF, 0x00, 0x04, 0x03, 0x02, 0x01}),
+              "enable config frame");
+static_assert(frame_equals(CommandFrame<CMD_DISABLE_CONFIG>::value,
+                           FixedFrame{0xFD, 0xFC, 0xFB, 0xFA, 0x02, 0x00, 0xFE, 0x00, 0x04, 0x03, 0x02, 0x01}),
+              "disable config frame");
+static_assert(frame_equals(CommandFrame<CMD_GET_CALIBRATION_STATUS>::value,
+                           FixedFrame{0xFD, 0xFC, 0xFB, 0xFA, 0x02, 0x00, 0x0A, 0x00, 0x04, 0x03, 0x02, 0x01}),
+              "calibration status frame");
+
+constexpr bool engineering_mode_frame_ok() {
+  const uint8_t value[] = {0x00, 0x00, 0x04, 0x00, 0x00, 0x00};
+  const uint8_t expected[] = {0xFD, 0xFC, 0xFB, 0xFA, 0x08, 0x00, 0x12, 0x00, 0x00,
+                              0x00, 0x04, 0x00, 0x00, 0x00, 0x04, 0x03, 0x02, 0x01};
+  uint8_t out[FRAME_OVERHEAD + sizeof(value)] = {};
+  if (encode_frame(CMD_SET_MODE, value, sizeof(value), out) != sizeof(expected))
+    return false;
+  for (size_t i = 0; i < sizeof(expected); i++) {
+    if (out[i] != expected[i])
+      return false;
+  }
+  return true;
+}
+static_assert(engineering_mode_frame_ok(), "set mode frame");
+
+// Maintenance scheduler
+static const uint8_t MAX_MAINTENANCE_TASKS = 4;
+static const uint32_t MAX_MAINTENANCE_JITTER_MS = 5 * 60 * 1000;
+
+// Outcome of the last power interference check; UNKNOWN means the check itself failed
+enum class PowerInterferenceState : uint8_t {
+  UNKNOWN,
+  NOT_PERFORMED,  // Module reports it hasn't run its own check
+  NONE,
+  DETECTED,
+};
+
+// What the demultiplexer is currently collecting
+enum class DemuxState : uint8_t {
+  TEXT,           // Plain text lines ("distance:xxx", "OFF")
+  COMMAND_FRAME,  // FD FC FB FA ... 04 03 02 01 (ACKs and notifications)
+  DATA_FRAME,     // F4 F3 F2 F1 ... F8 F7 F6 F5 (measurement frames)
+};
+
+enum class StartupState : uint8_t {
+  LISTENING,    // Watching for data frames / distance lines
+  NORMALISING,  // Background config session in progress
+  DONE,
+};
 
 // Add calibration coefficients
 static const uint8_t DEFAULT_COEFF = 0x1E;  // Default coefficient (3.0)
+static const uint32_t DEFAULT_CALIBRATION_POLL_MS = 1000;
+static const uint32_t DEFAULT_CALIBRATION_TIMEOUT_MS = 60000;  // Calibration normally takes 10-15 s
 static const float MIN_COEFF = 1.0f;
 static const float MAX_COEFF = 20.0f;
 
+// Optional subsystems are compiled in only when codegen emits their define, i.e. when an
+// entity needs them or the YAML lists them under features:
+//   USE_HLK_LD2402_ENGINEERING    engineering mode and per-gate energy decoding
+//   USE_HLK_LD2402_CALIBRATION    automatic threshold generation and its progress polling
+//   USE_HLK_LD2402_TEXT_PROTOCOL  "distance:" / "OFF" text lines and passive version detection
+//   USE_HLK_LD2402_THRESHOLDS     threshold sensors, reads and per-gate writes
 class HLKLD2402Component : public Component, public uart::UARTDevice {
 public:
   float get_setup_priority() const override { return setup_priority::LATE; }
 
   void set_distance_sensor(sensor::Sensor *distance_sensor) { distance_sensor_ = distance_sensor; }
   void set_distance_throttle(uint32_t throttle_ms) { distance_throttle_ms_ = throttle_ms; }
+  void set_distance_aggregation(Aggregation aggregation) { distance_aggregation_ = aggregation; }
+  void set_presence_policy(uint8_t enter_frames, uint32_t hold_ms, float range_cm, float hysteresis_cm) {
+    presence_policy_ = PresencePolicy{enter_frames, hold_ms, range_cm, hysteresis_cm};
+  }
+  // Called on every change of the debounced target state, after the binary sensors published it
+  void add_on_target_state_callback(std::function<void(TargetState)> &&callback) {
+    target_state_callback_.add(std::move(callback));
+  }
+  TargetState get_target_state() const { return target_state_; }
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  void set_distance_velocity_sensor(sensor::Sensor *velocity_sensor) { distance_velocity_sensor_ = velocity_sensor; }
+  void set_distance_filter(uint8_t median_window, float alpha, float beta) {
+    distance_median_.size = std::min<uint8_t>(std::max<uint8_t>(median_window, 1), MAX_MEDIAN_WINDOW);
+    distance_tracker_.alpha = alpha;
+    distance_tracker_.beta = beta;
+  }
+#endif
   void set_presence_binary_sensor(binary_sensor::BinarySensor *presence) { presence_binary_sensor_ = presence; }
   void set_micromovement_binary_sensor(binary_sensor::BinarySensor *micro) { micromovement_binary_sensor_ = micro; }
   void set_power_interference_binary_sensor(binary_sensor::BinarySensor *power_interference) { power_interference_binary_sensor_ = power_interference; }
-  void set_max_distance(float max_distance) { max_distance_ = max_distance; }
-  void set_timeout(uint32_t timeout) { timeout_ = timeout; }
+  // Declared values are written to the device by the startup reconciler when they differ
+  void set_max_distance(float max_distance) {
+    max_distance_ = max_distance;
+    set_desired_parameter_(PARAM_SLOT_MAX_DISTANCE, static_cast<uint32_t>(max_distance * 10.0f + 0.5f));  // Decimeters
+  }
+  void set_timeout(uint32_t timeout) {
+    timeout_ = timeout;
+    set_desired_parameter_(PARAM_SLOT_TIMEOUT, timeout);
+  }
+  void set_desired_motion_threshold(uint8_t gate, float db_value) {
+    if (gate < THRESHOLD_GATES)
+      set_desired_parameter_(PARAM_SLOT_MOTION_BASE + gate, db_to_threshold_(db_value));
+  }
+  void set_desired_micromotion_threshold(uint8_t gate, float db_value) {
+    if (gate < THRESHOLD_GATES)
+      set_desired_parameter_(PARAM_SLOT_MICRO_BASE + gate, db_to_threshold_(db_value));
+  }
   
   void set_firmware_version_text_sensor(text_sensor::TextSensor *version_sensor) { 
     this->firmware_version_text_sensor_ = version_sensor; 
@@ -88,61 +712,105 @@ public:
     this->operating_mode_text_sensor_ = mode_sensor;
   }
   
+  void set_command_latency_text_sensor(text_sensor::TextSensor *latency_sensor) {
+    this->command_latency_text_sensor_ = latency_sensor;
+  }
+  void set_stream_health_text_sensor(text_sensor::TextSensor *health_sensor) {
+    this->stream_health_text_sensor_ = health_sensor;
+  }
+  void set_auto_gain_text_sensor(text_sensor::TextSensor *auto_gain_sensor) {
+    this->auto_gain_text_sensor_ = auto_gain_sensor;
+  }
+  // Called after auto gain completed and the refreshed thresholds were published
+  void add_on_auto_gain_complete_callback(std::function<void()> &&callback) {
+    auto_gain_complete_callback_.add(std::move(callback));
+  }
+  void set_power_interference_text_sensor(text_sensor::TextSensor *status_sensor) {
+    this->power_interference_text_sensor_ = status_sensor;
+  }
+  
+#ifdef USE_HLK_LD2402_CALIBRATION
   void set_calibration_progress_sensor(sensor::Sensor *calibration_progress) { calibration_progress_sensor_ = calibration_progress; }
+  void set_calibration_poll_interval(uint32_t interval_ms) { calibration_poll_interval_ms_ = interval_ms; }
+  void set_calibration_timeout(uint32_t timeout_ms) { calibration_timeout_ms_ = timeout_ms; }
+#endif
+  void set_saves_avoided_sensor(sensor::Sensor *saves_avoided) { saves_avoided_sensor_ = saves_avoided; }
+  void set_command_errors_sensor(sensor::Sensor *errors) { command_errors_sensor_ = errors; }
+  void set_command_error_rate_sensor(sensor::Sensor *error_rate) { command_error_rate_sensor_ = error_rate; }
+  void set_stream_recoveries_sensor(sensor::Sensor *recoveries) { stream_recoveries_sensor_ = recoveries; }
+  void set_stall_timeout(uint32_t stall_timeout_ms) { stall_timeout_ms_ = stall_timeout_ms; }
+  void set_save_delay(uint32_t save_delay_ms) { save_delay_ms_ = save_delay_ms; }
+  void set_retry_policy(uint8_t attempts, uint32_t base_delay_ms, uint32_t jitter_ms, uint32_t deadline_ms) {
+    retry_policy_ = RetryPolicy{attempts, base_delay_ms, jitter_ms, deadline_ms};
+  }
+  void set_circuit_breaker(uint8_t threshold, uint32_t cooldown_ms) {
+    breaker_threshold_ = threshold;
+    breaker_cooldown_ms_ = cooldown_ms;
+  }
+  void set_firmware_version_delay(uint32_t delay_ms) { firmware_version_delay_ms_ = delay_ms; }
+  void set_power_interference_delay(uint32_t delay_ms) { power_interference_delay_ms_ = delay_ms; }
+  void set_power_interference_interval(uint32_t interval_ms) { power_interference_interval_ms_ = interval_ms; }
   
+#ifdef USE_HLK_LD2402_ENGINEERING
   void set_energy_gate_sensor(uint8_t gate_index, sensor::Sensor *energy_sensor) {
-    if (gate_index < MAX_GATES) {  // Use the constant for consistency
-      if (energy_gate_sensors_.size() <= gate_index) {
-        energy_gate_sensors_.resize(gate_index + 1, nullptr);
-      }
-      energy_gate_sensors_[gate_index] = energy_sensor;
+    if (energy_gate_sensors_.set(gate_index, energy_sensor))
       engineering_data_enabled_ = true; // Enable engineering data processing
-    }
   }
   
+  void set_micromotion_energy_gate_sensor(uint8_t gate_index, sensor::Sensor *energy_sensor) {
+    if (micromotion_energy_gate_sensors_.set(gate_index, energy_sensor))
+      engineering_data_enabled_ = true;
+  }
+  void set_engineering_throttle(uint32_t throttle_ms) { engineering_throttle_ms_ = throttle_ms; }
+  void set_energy_aggregation(Aggregation aggregation) { energy_aggregation_ = aggregation; }
+  void set_energy_deadband(float absolute, float relative, uint32_t heartbeat_ms) {
+    energy_deadband_ = DeadbandPolicy{absolute, relative, heartbeat_ms};
+  }
+#endif
+  
+#ifdef USE_HLK_LD2402_THRESHOLDS
   // Add threshold sensor setters
   void set_motion_threshold_sensor(uint8_t gate_index, sensor::Sensor *threshold_sensor) {
-    if (gate_index < MAX_GATES) {
-      if (motion_threshold_sensors_.size() <= gate_index) {
-        motion_threshold_sensors_.resize(gate_index + 1, nullptr);
-      }
-      motion_threshold_sensors_[gate_index] = threshold_sensor;
-    }
+    motion_threshold_sensors_.set(gate_index, threshold_sensor);
   }
   
   void set_micromotion_threshold_sensor(uint8_t gate_index, sensor::Sensor *threshold_sensor) {
-    if (gate_index < MAX_GATES) {
-      if (micromotion_threshold_sensors_.size() <= gate_index) {
-        micromotion_threshold_sensors_.resize(gate_index + 1, nullptr);
-      }
-      micromotion_threshold_sensors_[gate_index] = threshold_sensor;
-    }
+    micromotion_threshold_sensors_.set(gate_index, threshold_sensor);
   }
+#endif
   
   void setup() override;
   void loop() override;
   void dump_config() override;
   
+#ifdef USE_HLK_LD2402_CALIBRATION
   void calibrate();
-  void save_config();
-  void enable_auto_gain();
-  void check_power_interference();
+  // Queues the calibration; returns false if one is already running
+  bool calibrate_with_coefficients(float trigger_coeff, float hold_coeff, float micromotion_coeff);
+#endif
+  void save_config();  // Deferred: coalesced into one flash write after save_delay
+  void enable_auto_gain();  // Returns at once; completion arrives as a notification
+  void check_power_interference();  // Runs the scheduled check as soon as the queue is free
   void factory_reset();  // Add new factory reset method
   
   // Add new direct mode setting methods
+#ifdef USE_HLK_LD2402_ENGINEERING
   void set_engineering_mode_direct();
+#endif
   void set_normal_mode_direct();
   
   // Keep existing methods for backward compatibility
+#ifdef USE_HLK_LD2402_ENGINEERING
   void set_engineering_mode();
+#endif
   void set_normal_mode();
   
   void get_serial_number();
 
+#ifdef USE_HLK_LD2402_THRESHOLDS
   // Add new threshold setting methods
   bool set_motion_threshold(uint8_t gate, float db_value);
   bool set_micromotion_threshold(uint8_t gate, float db_value);
-  bool calibrate_with_coefficients(float trigger_coeff, float hold_coeff, float micromotion_coeff);
 
   // Service for setting motion threshold for a specific gate
   void set_gate_motion_threshold(int gate, float db_value) {
@@ -166,81 +834,407 @@ public:
   void read_micromotion_thresholds() {
     get_all_micromotion_thresholds();
   }
+#endif
 
 protected:
-  bool enter_config_mode_();
+  CommandResult enter_config_mode_();
   bool enter_config_mode_quick_();  // New quick entry method
   bool exit_config_mode_();
   bool send_command_(uint16_t command, const uint8_t *data = nullptr, size_t len = 0);
-  bool read_response_(std::vector<uint8_t> &response, uint32_t timeout_ms = 1000);  // Added timeout parameter
+  // Table-driven codec: encode the command value, then validate the ACK and return what follows its status
+  static bool encode_payload_(const CommandDescriptor &desc, const uint32_t *args, size_t arg_count, uint8_t *out,
+                              size_t &len);
+  static CommandResult decode_ack_(const CommandDescriptor &desc, size_t arg_count, const std::vector<uint8_t> &frame,
+                                   std::vector<uint8_t> &payload);
+  // Blocking send + wait + decode; payload may be null when only success matters
+  CommandResult execute_command_(uint16_t opcode, const uint32_t *args, size_t arg_count,
+                                 std::vector<uint8_t> *payload = nullptr);
+  CommandResult transact_(const CommandDescriptor &desc, const uint8_t *data, size_t len, size_t arg_count,
+                          std::vector<uint8_t> *payload);
+  CommandResult execute_command_(uint16_t opcode, std::initializer_list<uint32_t> args = {},
+                                 std::vector<uint8_t> *payload = nullptr) {
+    return execute_command_(opcode, args.begin(), args.size(), payload);
+  }
+  bool wait_for_frame_(uint16_t command, std::vector<uint8_t> &response, uint32_t timeout_ms);
+  void pump_uart_();
+  void feed_byte_(uint8_t c);
+  void route_command_frame_(const std::vector<uint8_t> &frame);
+  void dispatch_data_frame_(const std::vector<uint8_t> &frame);
+  void handle_text_byte_(uint8_t c);
   bool set_parameter_(uint16_t param_id, uint32_t value);
   bool get_parameter_(uint16_t param_id, uint32_t &value);
   bool set_work_mode_(uint32_t mode);
-  bool set_work_mode_with_timeout_(uint32_t mode, uint32_t timeout_ms);  // New method with timeout
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
   void process_line_(const std::string &line);
+#endif
   void dump_hex_(const uint8_t *data, size_t len, const char* prefix);
-  bool write_frame_(const std::vector<uint8_t> &frame);  // New method
-  void get_firmware_version_();  // Add the missing function declaration
+  static const uint8_t *fixed_frame_(uint16_t command);
+  void queue_firmware_version_read_(std::function<void()> &&done);
+  void queue_power_interference_read_(std::function<void()> &&done);
+  void publish_power_interference_(PowerInterferenceState state);
   void begin_passive_version_detection_();  // New method for passive detection
   void publish_operating_mode_();  // New method to publish the current operating mode
   
   bool save_configuration_();
-  bool enable_auto_gain_();
   bool get_serial_number_hex_();
   bool get_serial_number_char_();
 
   // Convert dB value to raw threshold
   uint32_t db_to_threshold_(float db_value);
+#ifdef USE_HLK_LD2402_THRESHOLDS
   float threshold_to_db_(uint32_t threshold);
+#endif
 
-  bool parse_data_frame_(const std::vector<uint8_t> &frame_data);
-  bool process_distance_frame_(const std::vector<uint8_t> &frame_data);
-  bool process_engineering_data_(const std::vector<uint8_t> &frame_data);
-  bool process_engineering_from_distance_frame_(const std::vector<uint8_t> &frame_data); // New method
-  void update_binary_sensors_(float distance_cm);  // New helper method
+  // Data frame handlers, registered in setup() and dispatched by dispatch_data_frame_()
+  using DataFrameHandlerFn = bool (HLKLD2402Component::*)(const DataFrameView &frame);
+  struct DataFrameHandler {
+    const char *name;
+    size_t min_size;
+    DataFrameHandlerFn handle;
+    uint32_t frames;
+    uint32_t failures;
+    uint32_t total_us;  // Decode time, so per-type cost can be compared
+    uint32_t max_us;
+  };
+  void register_data_frame_handler_(uint8_t type, StreamMode mode, const char *name, size_t min_size,
+                                    DataFrameHandlerFn handle);
+  StreamMode stream_mode_() const {
+    return operating_mode_ == "Engineering" ? StreamMode::ENGINEERING : StreamMode::NORMAL;
+  }
+  void log_data_frame_stats_();
+  bool process_distance_frame_(const DataFrameView &frame_data);
+  bool publish_distance_(float distance_cm);  // True when the throttle window closed and a value went out
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  float filter_distance_(float distance_cm, uint32_t now);
+#endif
+#ifdef USE_HLK_LD2402_ENGINEERING
+  bool process_engineering_from_distance_frame_(const DataFrameView &frame_data);
+  static void decode_gate_energies_(const DataFrameView &frame, size_t offset, uint8_t gates, GateEnergies &out);
+  static bool decode_engineering_frame_(const DataFrameView &frame, EngineeringFrame &out);
+  bool handle_engineering_frame_(const DataFrameView &frame, const char *label);
+  bool publish_gate_energy_(const GateSensors &sensors, GatePublishState &state, uint8_t gate, float value,
+                            uint32_t now);
+#endif
+  // Presence state machine; per-frame input is a few compares, publishes happen on transitions
+  void observe_target_(TargetState observed, float distance_cm, uint32_t now);
+  void expire_target_(uint32_t now);
+  void set_target_state_(TargetState state);
+  void publish_target_state_();
 
+#ifdef USE_HLK_LD2402_THRESHOLDS
   // Batch parameter reading method
   bool get_parameters_batch_(const std::vector<uint16_t> &param_ids, std::vector<uint32_t> &values);
+  void publish_thresholds_(bool micromotion, const std::vector<uint32_t> &values);
+  void queue_threshold_refresh_(std::function<void()> &&done);  // Inside an open config session
+#endif
 
-private:
-  // According to manual, response timeout should be 1s
-  static const uint32_t RESPONSE_TIMEOUT_MS = 1000;
+#ifdef USE_HLK_LD2402_CALIBRATION
+  // Calibration runs on the async queue and is polled from loop()
+  void run_calibration_();
+  void finish_calibration_(bool completed);
+#endif
+
+  // Non-blocking command path, driven from loop(). On success callbacks receive the
+  // decoded ACK payload, i.e. what decode_ack_() returns. Not allocation-free: the deque,
+  // the std::function captures and the payload vectors all use the heap.
+  using CommandCallback = std::function<void(const CommandResult &result, const std::vector<uint8_t> &payload)>;
+  struct QueuedCommand {
+    const CommandDescriptor *desc;
+    uint8_t data[MAX_COMMAND_PAYLOAD];
+    uint8_t len;
+    uint8_t arg_count;
+    uint8_t attempt;
+    uint32_t started_at;
+    uint32_t not_before;  // Backoff: don't send before this time
+    CommandCallback callback;
+  };
+  void complete_queued_(const CommandResult &result, const std::vector<uint8_t> &payload);
+  void queue_command_(uint16_t opcode, const uint32_t *args, size_t arg_count, CommandCallback callback);
+  void queue_command_(uint16_t opcode, std::initializer_list<uint32_t> args, CommandCallback callback) {
+    queue_command_(opcode, args.begin(), args.size(), std::move(callback));
+  }
+  bool command_queue_busy_() const { return command_in_flight_ || !command_queue_.empty(); }
   
+  // Per-command statistics: outcome counters plus the last LATENCY_SAMPLES ACK latencies
+  struct CommandStats {
+    uint32_t outcomes[COMMAND_ERROR_COUNT];
+    uint16_t samples[LATENCY_SAMPLES];
+    uint8_t count;
+    uint8_t next;
+  };
+  void record_latency_(const CommandDescriptor &desc, uint32_t latency_ms, uint8_t units);
+  void record_outcome_(const CommandDescriptor &desc, const CommandResult &result);
+  uint32_t latency_percentile_(const CommandDescriptor &desc, uint8_t percentile) const;
+  uint32_t response_timeout_(const CommandDescriptor &desc, uint8_t units) const;
+  void handle_response_timeout_(const CommandDescriptor &desc, uint32_t timeout_ms);
+  void publish_command_stats_();
+  
+  // Retry engine and circuit breaker
+  static bool retryable_(const CommandDescriptor &desc, const CommandResult &result);
+  uint32_t retry_delay_(const RetryPolicy &policy, uint8_t failed_attempts) const;
+  bool retry_allowed_(const RetryPolicy &policy, uint8_t failed_attempts, uint32_t started_at, uint32_t delay_ms) const;
+  BreakerState breaker_state_() const;
+  bool breaker_open_() const;  // Open, or half-open with the probe still out
+  bool breaker_admit_();       // Called right before a send; false holds the command back
+  void update_breaker_(const CommandDescriptor &desc, const CommandResult &result);
+  void pump_for_(uint32_t duration_ms);
+  void process_command_queue_();
+
+  // Unsolicited frame registry
+  using NotificationHandler = std::function<void(const std::vector<uint8_t> &frame)>;
+  void register_notification_handler_(uint16_t opcode, NotificationHandler &&handler);
+  bool dispatch_notification_(uint16_t opcode, const std::vector<uint8_t> &frame);
+  
+  // Auto gain runs in an open config session until the completion notification arrives
+  void handle_auto_gain_complete_(const std::vector<uint8_t> &frame);
+  void run_auto_gain_();
+  void finish_auto_gain_(AutoGainState state);
+  void publish_auto_gain_state_();
+
+  // Stream watchdog
+  void note_stream_unit_();
+  void note_desync_();
+  void run_watchdog_();
+  uint32_t stall_threshold_() const;
+  void run_recovery_step_(RecoveryStep step);
+  void resync_parser_();
+  void publish_stream_health_();
+
+  // Async config session helpers; the callback learns whether config mode was entered
+  void queue_enter_config_(std::function<void(bool)> &&done);
+  void queue_exit_config_(std::function<void()> &&done);
+
+  // Maintenance scheduler. A task's run() queues async commands and calls done when
+  // finished; due tasks that need config mode are run back to back in one session.
+  using MaintenanceJob = std::function<void(std::function<void()> done)>;
+  struct MaintenanceTask {
+    const char *name;
+    uint8_t priority;      // Higher runs first when several tasks are due together
+    uint32_t interval_ms;  // 0 for one-shot tasks
+    uint32_t jitter_ms;    // Random spread added to each periodic run
+    uint32_t next_run;
+    bool needs_config;
+    bool enabled;
+    MaintenanceJob run;
+  };
+  void add_maintenance_task_(const char *name, uint8_t priority, uint32_t first_delay_ms, uint32_t interval_ms,
+                             uint32_t jitter_ms, bool needs_config, MaintenanceJob &&run);
+  void run_scheduler_();
+  void run_maintenance_batch_(std::vector<MaintenanceTask *> tasks, size_t index, std::function<void()> done);
+  void reschedule_task_(MaintenanceTask &task);
+
+  // Background startup sequence
+  void run_startup_();
+  void start_startup_session_(bool normalise);
+  void finish_startup_session_();
+
+  // Desired-state reconciliation against the parameter shadow
+  void set_desired_parameter_(uint8_t slot, uint32_t value) {
+    desired_values_[slot] = value;
+    desired_mask_ |= (1ULL << slot);
+  }
+  static int param_slot_(uint16_t param_id);
+  static uint16_t slot_param_id_(uint8_t slot);
+  void update_shadow_(uint16_t param_id, uint32_t value, bool written = false);
+  void reconcile_parameters_(std::function<void()> &&done);
+  void write_reconciled_parameters_(std::function<void()> &&done);
+  bool parse_parameter_values_(const std::vector<uint8_t> &payload, const std::vector<uint16_t> &param_ids,
+                               std::vector<uint32_t> &values);
+
+  // Flash save bookkeeping
+  bool has_unsaved_changes_() const;
+  void mark_saved_();
+  bool save_if_changed_();  // Must be called in config mode
+  void flush_pending_save_();
+
+private:
   sensor::Sensor *distance_sensor_{nullptr};
-  sensor::Sensor *calibration_progress_sensor_{nullptr};
+  sensor::Sensor *saves_avoided_sensor_{nullptr};
+  sensor::Sensor *command_errors_sensor_{nullptr};
+  sensor::Sensor *command_error_rate_sensor_{nullptr};
+  sensor::Sensor *stream_recoveries_sensor_{nullptr};
   binary_sensor::BinarySensor *presence_binary_sensor_{nullptr};
   binary_sensor::BinarySensor *micromovement_binary_sensor_{nullptr};
   binary_sensor::BinarySensor *power_interference_binary_sensor_{nullptr};
   
   text_sensor::TextSensor *firmware_version_text_sensor_{nullptr};
   text_sensor::TextSensor *operating_mode_text_sensor_{nullptr};
+  text_sensor::TextSensor *power_interference_text_sensor_{nullptr};
+  text_sensor::TextSensor *command_latency_text_sensor_{nullptr};
+  text_sensor::TextSensor *stream_health_text_sensor_{nullptr};
+  text_sensor::TextSensor *auto_gain_text_sensor_{nullptr};
   
   float max_distance_{5.0};
   uint32_t timeout_{5};
   bool config_mode_{false};
   std::string firmware_version_;
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
   std::string line_buffer_;
+#endif
   bool power_interference_detected_{false};
-  uint32_t last_calibration_status_{0};
-  bool calibration_in_progress_{false};
+  PowerInterferenceState power_interference_state_{PowerInterferenceState::UNKNOWN};
+  bool power_interference_published_{false};
+  bool calibration_in_progress_{false};  // Checked by the scheduler and watchdog in every build
+#ifdef USE_HLK_LD2402_CALIBRATION
+  sensor::Sensor *calibration_progress_sensor_{nullptr};
+  uint32_t calibration_started_at_{0};
   uint32_t last_calibration_check_{0};   // Time of last calibration check
   uint32_t calibration_progress_{0};     // Current calibration progress (0-100)
+  uint32_t calibration_poll_interval_ms_{DEFAULT_CALIBRATION_POLL_MS};
+  uint32_t calibration_timeout_ms_{DEFAULT_CALIBRATION_TIMEOUT_MS};
+#endif
   std::string serial_number_; // Add field to store serial number
   std::string operating_mode_{"Normal"};  // Track the current operating mode
   uint32_t last_distance_update_{0};   // Time of last distance sensor update
   uint32_t distance_throttle_ms_{2000}; // Default throttle of 2 seconds
+  Aggregation distance_aggregation_{Aggregation::LAST};
+  WindowAggregate distance_window_;
+#ifdef USE_HLK_LD2402_DISTANCE_FILTER
+  sensor::Sensor *distance_velocity_sensor_{nullptr};
+  SlidingMedian distance_median_;
+  AlphaBetaTracker distance_tracker_;
+#endif
+#ifdef USE_HLK_LD2402_ENGINEERING
   uint32_t last_engineering_update_{0}; // Time of last engineering data update
-  uint32_t engineering_throttle_ms_{2000}; // Engineering data throttle (2 seconds)
-  std::vector<sensor::Sensor *> energy_gate_sensors_; // Store gate sensors
+  uint32_t engineering_throttle_ms_{DEFAULT_ENGINEERING_THROTTLE_MS}; // Engineering data throttle
+  DeadbandPolicy energy_deadband_{DEFAULT_ENERGY_DEADBAND};
+  Aggregation energy_aggregation_{Aggregation::LAST};
+  WindowAggregate motion_energy_window_[ACTIVE_GATES];
+  WindowAggregate micromotion_energy_window_[ACTIVE_GATES];
+  GatePublishState motion_energy_published_;
+  GatePublishState micromotion_energy_published_;
+  uint32_t energy_publishes_{0};
+  uint32_t energy_publishes_skipped_{0};
+  GateSensors energy_gate_sensors_; // Store gate sensors
+  GateSensors micromotion_energy_gate_sensors_;
+  EngineeringFrame engineering_frame_;  // Last decoded engineering frame
   bool engineering_data_enabled_{false}; // Flag to enable engineering data processing
+#endif
   
+#ifdef USE_HLK_LD2402_THRESHOLDS
   // Add storage for threshold sensors
-  std::vector<sensor::Sensor *> motion_threshold_sensors_;
-  std::vector<sensor::Sensor *> micromotion_threshold_sensors_;
+  ThresholdSensors motion_threshold_sensors_;
+  ThresholdSensors micromotion_threshold_sensors_;
   
   // Add cache for threshold values
-  std::vector<float> motion_threshold_values_;
-  std::vector<float> micromotion_threshold_values_;
+  float motion_threshold_values_[THRESHOLD_GATES]{};
+  float micromotion_threshold_values_[THRESHOLD_GATES]{};
+#endif
+
+  // Last known device value for each writable parameter, plus the values declared in YAML
+  uint32_t shadow_values_[PARAM_SLOT_COUNT]{};
+  uint64_t shadow_valid_mask_{0};
+  uint32_t desired_values_[PARAM_SLOT_COUNT]{};
+  uint64_t desired_mask_{0};
+  
+  // What the module's flash holds, as far as we know, and what was written since
+  uint32_t saved_values_[PARAM_SLOT_COUNT]{};
+  uint64_t saved_valid_mask_{0};
+  uint64_t written_mask_{0};
+  bool unshadowed_changes_{false};  // Calibration/auto gain changed state we can't compare
+  bool save_pending_{false};
+  uint32_t save_requested_at_{0};
+  uint32_t save_delay_ms_{5000};
+  uint32_t saves_avoided_{0};
+  
+  // Startup sequence and the async command queue behind it
+  StartupState startup_state_{StartupState::LISTENING};
+  uint32_t startup_started_at_{0};
+  bool measurement_seen_{false};  // A valid data frame or distance line has been parsed
+  std::deque<QueuedCommand> command_queue_;
+  bool command_in_flight_{false};
+  uint32_t command_sent_at_{0};      // Set by send_command_() for both command paths
+  uint32_t command_timeout_ms_{0};   // Adaptive timeout of the in-flight queued command
+  CommandStats command_stats_[COMMAND_COUNT]{};
+  RetryPolicy retry_policy_{DEFAULT_RETRY_POLICY};
+  uint8_t breaker_threshold_{DEFAULT_BREAKER_THRESHOLD};
+  uint32_t breaker_cooldown_ms_{DEFAULT_BREAKER_COOLDOWN_MS};
+  uint8_t consecutive_timeouts_{0};
+  uint32_t breaker_opened_at_{0};
+  bool breaker_probe_in_flight_{false};
+  bool command_stats_changed_{false};
+  
+  // Stream demultiplexer state
+  DemuxState demux_state_{DemuxState::TEXT};
+  uint32_t header_window_{0};
+  std::vector<uint8_t> frame_buffer_;
+  bool awaiting_response_{false};   // A blocking helper is waiting in wait_for_frame_()
+  uint16_t awaited_command_{0};
+  std::vector<uint8_t> awaited_response_;
+  bool response_ready_{false};
+  uint16_t last_sent_command_{0};
+  uint8_t last_sent_units_{1};  // latency_units() of the command in flight
+  uint32_t last_byte_time_{0};
+  uint32_t status_byte_count_{0};
+  uint8_t last_bytes_[16]{};
+  uint8_t last_byte_pos_{0};
+#ifdef USE_HLK_LD2402_TEXT_PROTOCOL
+  uint32_t last_line_log_time_{0};
+#endif
+  
+  // Stream watchdog: cadence of complete frames/lines, escalation state and counters
+  uint32_t last_stream_unit_at_{0};
+  uint32_t stream_cadence_ms_{0};     // Smoothed interval between frames/lines, 0 until learned
+  uint32_t stall_timeout_ms_{DEFAULT_STALL_TIMEOUT_MS};
+  uint8_t recovery_level_{0};         // Steps taken in the current stall, 0 while healthy
+  uint32_t last_recovery_at_{0};
+  uint8_t desync_events_{0};
+  uint32_t desync_window_start_{0};
+  uint32_t stalls_detected_{0};
+  uint32_t desyncs_detected_{0};
+  uint32_t recovery_counts_[RECOVERY_STEP_COUNT]{};
+  
+  // Notification handlers; slot index + 1 per opcode, 0 when nothing is registered
+  uint8_t notification_slots_[NOTIFICATION_OPCODE_LIMIT]{};
+  NotificationHandler notification_handlers_[MAX_NOTIFICATION_HANDLERS];
+  uint8_t notification_handler_count_{0};
+  uint32_t unhandled_notifications_{0};
+  AutoGainState auto_gain_state_{AutoGainState::IDLE};
+  uint32_t auto_gain_started_at_{0};
+  CallbackManager<void()> auto_gain_complete_callback_;
+  
+  PresencePolicy presence_policy_{DEFAULT_PRESENCE_POLICY};
+  TargetState target_state_{TargetState::NONE};
+  TargetState target_candidate_{TargetState::NONE};  // Class waiting for enter_frames confirmations
+  uint8_t target_candidate_frames_{0};
+  uint32_t target_seen_at_{0};
+  bool target_published_{false};  // Binary sensors get the initial state with the first frame
+  CallbackManager<void(TargetState)> target_state_callback_;
+  
+  // Data frame handlers; slot index + 1 per (type, mode), 0 when nothing is registered
+  uint8_t data_handler_slots_[DATA_FRAME_TYPE_SLOTS][STREAM_MODE_COUNT]{};
+  DataFrameHandler data_handlers_[MAX_DATA_FRAME_HANDLERS]{};
+  uint8_t data_handler_count_{0};
+  uint32_t unknown_frame_types_{0};   // Unrecognised layout or no handler for it at all
+  uint32_t unhandled_data_frames_{0}; // Known type, but nothing handles it in the current mode
+  uint32_t short_data_frames_{0};
+  uint8_t reconcile_writes_pending_{0};
+  uint8_t reconcile_written_{0};
+  
+  // Maintenance tasks and their YAML-configurable timing
+  MaintenanceTask maintenance_tasks_[MAX_MAINTENANCE_TASKS]{};
+  uint8_t maintenance_task_count_{0};
+  bool maintenance_running_{false};
+  int8_t power_interference_task_{-1};
+  uint32_t firmware_version_delay_ms_{20000};
+  uint32_t power_interference_delay_ms_{20000};
+  uint32_t power_interference_interval_ms_{0};  // 0 = check once after boot
+};
+
+class AutoGainCompleteTrigger : public Trigger<> {
+public:
+  explicit AutoGainCompleteTrigger(HLKLD2402Component *parent) {
+    parent->add_on_auto_gain_complete_callback([this]() { this->trigger(); });
+  }
+};
+
+const char *target_state_to_string(TargetState state);
+
+class TargetStateTrigger : public Trigger<std::string> {
+public:
+  explicit TargetStateTrigger(HLKLD2402Component *parent) {
+    parent->add_on_target_state_callback([this](TargetState state) { this->trigger(target_state_to_string(state)); });
+  }
 };
 
 }  // namespace hlk_ld2402
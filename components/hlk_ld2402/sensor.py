@@ -1,5 +1,6 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 from esphome.components import sensor
 from esphome.const import (
     CONF_ID,
@@ -10,50 +11,148 @@ from esphome.const import (
     ENTITY_CATEGORY_DIAGNOSTIC,
 )
 
-from . import HLKLD2402Component, CONF_HLK_LD2402_ID
+from . import (
+    HLKLD2402Component,
+    CONF_HLK_LD2402_ID,
+    THRESHOLD_GATES,
+    AGGREGATIONS,
+    active_gates,
+    enable_feature,
+    FEATURE_CALIBRATION,
+    FEATURE_ENGINEERING,
+    FEATURE_TEXT_PROTOCOL,
+    FEATURE_THRESHOLDS,
+    FEATURE_DISTANCE_FILTER,
+)
 
 CONF_THROTTLE = "throttle"
+CONF_AGGREGATION = "aggregation"  # Statistic published per throttle window
+CONF_SMOOTHING = "smoothing"  # On-device median and alpha-beta filter for the distance
+CONF_MEDIAN_WINDOW = "median_window"
+CONF_ALPHA = "alpha"
+CONF_BETA = "beta"
+CONF_VELOCITY = "velocity"  # Velocity estimate of the distance filter, in cm/s
 CONF_CALIBRATION_PROGRESS = "calibration_progress"
+CONF_SAVES_AVOIDED = "saves_avoided"  # Diagnostic count of skipped flash writes
+CONF_COMMAND_ERRORS = "command_errors"  # Diagnostic count of failed commands
+CONF_COMMAND_ERROR_RATE = "command_error_rate"  # Failed commands in percent
+CONF_STREAM_RECOVERIES = "stream_recoveries"  # Watchdog recovery steps taken
 CONF_ENERGY_GATE = "energy_gate"  # Energy gate sensors
-CONF_GATE_INDEX = "gate_index"     # Gate number (0-13)
+CONF_MICROMOTION_ENERGY_GATE = "micromotion_energy_gate"  # Micromotion energy bank of the same frame
+CONF_GATE_INDEX = "gate_index"     # Gate number (0-15), below the active gate count
 CONF_MOTION_THRESHOLD = "motion_threshold"  # Motion threshold sensors
 CONF_MICROMOTION_THRESHOLD = "micromotion_threshold"  # Micromotion threshold sensors
 
+
+def _odd_window(value):
+    value = cv.int_range(min=1, max=9)(value)
+    if value % 2 == 0:
+        raise cv.Invalid("median_window must be odd")
+    return value
+
+
+SMOOTHING_SCHEMA = cv.Schema({
+    cv.Optional(CONF_MEDIAN_WINDOW, default=5): _odd_window,
+    cv.Optional(CONF_ALPHA, default=0.5): cv.float_range(min=0.0, max=1.0, min_included=False),
+    cv.Optional(CONF_BETA, default=0.1): cv.float_range(min=0.0, max=1.0),
+})
+
 # Update schema to include threshold sensors
 CONFIG_SCHEMA = sensor.sensor_schema().extend({
     cv.GenerateID(): cv.declare_id(sensor.Sensor),
     cv.Required(CONF_HLK_LD2402_ID): cv.use_id(HLKLD2402Component),
     cv.Optional(CONF_THROTTLE): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_AGGREGATION): cv.enum(AGGREGATIONS, lower=True),
+    cv.Optional(CONF_SMOOTHING): SMOOTHING_SCHEMA,
+    cv.Optional(CONF_VELOCITY, default=False): cv.boolean,
     cv.Optional(CONF_CALIBRATION_PROGRESS, default=False): cv.boolean,
+    cv.Optional(CONF_SAVES_AVOIDED, default=False): cv.boolean,
+    cv.Optional(CONF_COMMAND_ERRORS, default=False): cv.boolean,
+    cv.Optional(CONF_COMMAND_ERROR_RATE, default=False): cv.boolean,
+    cv.Optional(CONF_STREAM_RECOVERIES, default=False): cv.boolean,
     cv.Optional(CONF_ENERGY_GATE): cv.Schema({
-        cv.Required(CONF_GATE_INDEX): cv.int_range(0, 14),  # Should be (0, 14) for 15 gates
+        cv.Required(CONF_GATE_INDEX): cv.int_range(0, THRESHOLD_GATES - 1),
+    }),
+    cv.Optional(CONF_MICROMOTION_ENERGY_GATE): cv.Schema({
+        cv.Required(CONF_GATE_INDEX): cv.int_range(0, THRESHOLD_GATES - 1),
     }),
     cv.Optional(CONF_MOTION_THRESHOLD): cv.Schema({
-        cv.Required(CONF_GATE_INDEX): cv.int_range(0, 15),
+        cv.Required(CONF_GATE_INDEX): cv.int_range(0, THRESHOLD_GATES - 1),
     }),
     cv.Optional(CONF_MICROMOTION_THRESHOLD): cv.Schema({
-        cv.Required(CONF_GATE_INDEX): cv.int_range(0, 15),
+        cv.Required(CONF_GATE_INDEX): cv.int_range(0, THRESHOLD_GATES - 1),
     }),
 })
 
+# Threshold parameters exist for all 16 gates whatever the range, so only energies are checked
+ENERGY_GATE_KEYS = (CONF_ENERGY_GATE, CONF_MICROMOTION_ENERGY_GATE)
+
+
+def _final_validate(config):
+    # Energies past max_distance are not decoded, so a sensor on one would never publish
+    key = next((k for k in ENERGY_GATE_KEYS if k in config), None)
+    if key is None:
+        return config
+    full_config = fv.full_config.get()
+    parent_path = full_config.get_path_for_id(config[CONF_HLK_LD2402_ID])[:-1]
+    gates = active_gates(full_config.get_config_for_path(parent_path))
+    if config[key][CONF_GATE_INDEX] >= gates:
+        raise cv.Invalid(
+            f"gate_index must be below {gates}, the number of gates within max_distance",
+            path=[key, CONF_GATE_INDEX],
+        )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
 async def to_code(config):
     parent = await cg.get_variable(config[CONF_HLK_LD2402_ID])
     var = await sensor.new_sensor(config)
     
     if CONF_ENERGY_GATE in config:
         gate_index = config[CONF_ENERGY_GATE][CONF_GATE_INDEX]
+        enable_feature(FEATURE_ENGINEERING)
         cg.add(parent.set_energy_gate_sensor(gate_index, var))
+    elif CONF_MICROMOTION_ENERGY_GATE in config:
+        gate_index = config[CONF_MICROMOTION_ENERGY_GATE][CONF_GATE_INDEX]
+        enable_feature(FEATURE_ENGINEERING)
+        cg.add(parent.set_micromotion_energy_gate_sensor(gate_index, var))
     elif CONF_MOTION_THRESHOLD in config:
         gate_index = config[CONF_MOTION_THRESHOLD][CONF_GATE_INDEX]
+        enable_feature(FEATURE_THRESHOLDS)
         cg.add(parent.set_motion_threshold_sensor(gate_index, var))
     elif CONF_MICROMOTION_THRESHOLD in config:
         gate_index = config[CONF_MICROMOTION_THRESHOLD][CONF_GATE_INDEX]
+        enable_feature(FEATURE_THRESHOLDS)
         cg.add(parent.set_micromotion_threshold_sensor(gate_index, var))
     elif config.get(CONF_CALIBRATION_PROGRESS):
         # This is a calibration progress sensor
+        enable_feature(FEATURE_CALIBRATION)
         cg.add(parent.set_calibration_progress_sensor(var))
+    elif config.get(CONF_SAVES_AVOIDED):
+        cg.add(parent.set_saves_avoided_sensor(var))
+    elif config.get(CONF_COMMAND_ERRORS):
+        cg.add(parent.set_command_errors_sensor(var))
+    elif config.get(CONF_COMMAND_ERROR_RATE):
+        cg.add(parent.set_command_error_rate_sensor(var))
+    elif config.get(CONF_STREAM_RECOVERIES):
+        cg.add(parent.set_stream_recoveries_sensor(var))
+    elif config.get(CONF_VELOCITY):
+        # Comes from the distance filter, which needs the distance stream
+        enable_feature(FEATURE_DISTANCE_FILTER)
+        enable_feature(FEATURE_TEXT_PROTOCOL)
+        cg.add(parent.set_distance_velocity_sensor(var))
     else:
-        # This is a regular distance sensor
+        # This is a regular distance sensor; normal mode reports it as text lines
+        enable_feature(FEATURE_TEXT_PROTOCOL)
         cg.add(parent.set_distance_sensor(var))
         if CONF_THROTTLE in config:
             cg.add(parent.set_distance_throttle(config[CONF_THROTTLE]))
+        if CONF_AGGREGATION in config:
+            cg.add(parent.set_distance_aggregation(config[CONF_AGGREGATION]))
+        if CONF_SMOOTHING in config:
+            smoothing = config[CONF_SMOOTHING]
+            enable_feature(FEATURE_DISTANCE_FILTER)
+            cg.add(parent.set_distance_filter(smoothing[CONF_MEDIAN_WINDOW], smoothing[CONF_ALPHA],
+                                              smoothing[CONF_BETA]))
@@ -11,6 +11,10 @@ from . import HLKLD2402Component, CONF_HLK_LD2402_ID
 # Define text sensor types
 CONF_FIRMWARE_VERSION = "firmware_version"
 CONF_OPERATING_MODE = "operating_mode"
+CONF_POWER_INTERFERENCE_STATUS = "power_interference_status"
+CONF_COMMAND_LATENCY = "command_latency"
+CONF_STREAM_HEALTH = "stream_health"
+CONF_AUTO_GAIN_STATUS = "auto_gain_status"
 
 # Define schema with optional sensor types
 CONFIG_SCHEMA = text_sensor.text_sensor_schema(
@@ -20,6 +24,10 @@ CONFIG_SCHEMA = text_sensor.text_sensor_schema(
     cv.Required(CONF_HLK_LD2402_ID): cv.use_id(HLKLD2402Component),
     cv.Optional(CONF_FIRMWARE_VERSION, default=False): cv.boolean,
     cv.Optional(CONF_OPERATING_MODE, default=False): cv.boolean,
+    cv.Optional(CONF_POWER_INTERFERENCE_STATUS, default=False): cv.boolean,
+    cv.Optional(CONF_COMMAND_LATENCY, default=False): cv.boolean,
+    cv.Optional(CONF_STREAM_HEALTH, default=False): cv.boolean,
+    cv.Optional(CONF_AUTO_GAIN_STATUS, default=False): cv.boolean,
 })
 
 async def to_code(config):
@@ -30,3 +38,11 @@ async def to_code(config):
         cg.add(parent.set_firmware_version_text_sensor(var))
     elif config.get(CONF_OPERATING_MODE):
         cg.add(parent.set_operating_mode_text_sensor(var))
+    elif config.get(CONF_POWER_INTERFERENCE_STATUS):
+        cg.add(parent.set_power_interference_text_sensor(var))
+    elif config.get(CONF_COMMAND_LATENCY):
+        cg.add(parent.set_command_latency_text_sensor(var))
+    elif config.get(CONF_STREAM_HEALTH):
+        cg.add(parent.set_stream_health_text_sensor(var))
+    elif config.get(CONF_AUTO_GAIN_STATUS):
+        cg.add(parent.set_auto_gain_text_sensor(var))